@@ -0,0 +1,140 @@
+/**
+ * LaosEstimator.cpp
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "LaosEstimator.h"
+
+LaosEstimator::LaosEstimator()
+{
+	Reset();
+}
+
+void LaosEstimator::Reset()
+{
+	m_Count = 0;
+	m_X = m_Y = 0;
+	m_HasPosition = false;
+	clear_vector(m_PrevUnitVec);
+	m_PrevNominalSpeed = 0;
+	m_Time = 0;
+	m_Stops = 0;
+}
+
+void LaosEstimator::SetPosition(float x, float y)
+{
+	m_X = x;
+	m_Y = y;
+	m_HasPosition = true;
+}
+
+// Add a move, like plan_buffer_line()
+void LaosEstimator::Move(float x, float y, float feedrate, float acceleration)
+{
+	float delta_mm[NUM_AXES], unit_vec[NUM_AXES];
+	bool known = m_HasPosition;
+	delta_mm[X_AXIS] = x - m_X;
+	delta_mm[Y_AXIS] = y - m_Y;
+	delta_mm[Z_AXIS] = delta_mm[E_AXIS] = 0;
+	SetPosition(x, y);
+	if(!known) return; // the first move starts where the head happens to be
+	float millimeters = sqrt(square(delta_mm[X_AXIS]) + square(delta_mm[Y_AXIS]));
+	if((millimeters == 0) || (feedrate <= 0)) return;
+
+	TBlock block;
+	block.millimeters = millimeters;
+	block.nominal_speed = millimeters * plan_speed_multiplier(delta_mm, millimeters, feedrate);
+	block.acceleration = acceleration;
+	for(int i=0; i < NUM_AXES; i++)
+		unit_vec[i] = delta_mm[i] / millimeters;
+	float vmax_junction = MINIMUM_PLANNER_SPEED;
+	if((m_Count > 0) && (m_PrevNominalSpeed > 0.0))
+		vmax_junction = plan_junction_speed(m_PrevUnitVec, m_PrevNominalSpeed, unit_vec, 
+			block.nominal_speed, acceleration);
+	block.max_entry_speed = vmax_junction;
+	float v_allowable = plan_max_allowable_speed(-acceleration, MINIMUM_PLANNER_SPEED, millimeters);
+	block.entry_speed = min(vmax_junction, v_allowable);
+	block.nominal_length_flag = (block.nominal_speed <= v_allowable);
+	memcpy(m_PrevUnitVec, unit_vec, sizeof(unit_vec));
+	m_PrevNominalSpeed = block.nominal_speed;
+
+	if(m_Count == ESTIMATOR_BLOCKS) // queue full: the oldest move is done first
+		Retire();
+	m_Block[m_Count++] = block;
+	Recalculate();
+}
+
+// Execute all queued moves
+void LaosEstimator::Flush()
+{
+	while(m_Count > 0)
+		Retire();
+}
+
+// Reverse and forward pass of the planner over the window. The first block is 
+// being executed, its entry speed does not change.
+void LaosEstimator::Recalculate()
+{
+	for(int i=m_Count-2; i > 0; i--)
+	{
+		TBlock *current = &m_Block[i], *next = &m_Block[i+1];
+		if(current->entry_speed != current->max_entry_speed)
+		{
+			if((!current->nominal_length_flag) && (current->max_entry_speed > next->entry_speed))
+				current->entry_speed = min(current->max_entry_speed,
+					plan_max_allowable_speed(-current->acceleration, next->entry_speed, current->millimeters));
+			else
+				current->entry_speed = current->max_entry_speed;
+		}
+	}
+	for(int i=1; i < m_Count; i++)
+	{
+		TBlock *previous = &m_Block[i-1], *current = &m_Block[i];
+		if((!previous->nominal_length_flag) && (previous->entry_speed < current->entry_speed))
+			current->entry_speed = min(current->entry_speed,
+				plan_max_allowable_speed(-previous->acceleration, previous->entry_speed, previous->millimeters));
+	}
+}
+
+// The oldest move is executed: add the time of its trapezoid
+void LaosEstimator::Retire()
+{
+	TBlock *b = &m_Block[0];
+	float a = b->acceleration;
+	float v0 = b->entry_speed / 60.0; // [mm/sec]
+	float v1 = (m_Count > 1 ? m_Block[1].entry_speed : MINIMUM_PLANNER_SPEED) / 60.0;
+	float vn = b->nominal_speed / 60.0;
+	float accel_mm = (vn*vn - v0*v0) / (2*a);
+	float decel_mm = (vn*vn - v1*v1) / (2*a);
+	if(accel_mm + decel_mm <= b->millimeters)
+	{
+		m_Time += (vn-v0)/a + (vn-v1)/a + (b->millimeters - accel_mm - decel_mm)/vn;
+	}
+	else // nominal speed is not reached
+	{
+		float vp = sqrt((2*a*b->millimeters + v0*v0 + v1*v1) / 2);
+		m_Time += (vp-v0)/a + (vp-v1)/a;
+	}
+	if(v1 <= MINIMUM_PLANNER_SPEED / 60.0) m_Stops++;
+	m_Count--;
+	memmove(&m_Block[0], &m_Block[1], m_Count * sizeof(TBlock));
+}
@@ -0,0 +1,86 @@
+/**
+ * LaosEstimator.h
+ * Job run time estimate
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LAOSESTIMATORH
+#define LAOSESTIMATORH
+
+#include "planner.h"
+#include "stepper.h"
+
+#define ESTIMATOR_BLOCKS (BLOCK_BUFFER_SIZE-1)   // look ahead of the planner (its ring keeps one slot free)
+
+    /** Estimate the run time of a job
+      * Moves are planned like plan_buffer_line() does (same speed limits, junction speeds 
+      * and look ahead), but not executed: the time of the trapezoid speed profile of each 
+      * move is added up when it leaves the look ahead window. 
+      * It is assumed that the planner queue never runs empty, except where the motion code
+      * waits for it (bitmap lines: call Flush()).
+      *
+      * Example:
+      * @code 
+      * LaosEstimator est;
+      * est.Move(10, 0, 6000, 200);
+      * est.Move(10, 10, 6000, 200);
+      * est.Flush();
+      * printf("%f sec\n", est.Time());
+      * @endcode
+      */
+class LaosEstimator {
+
+public:
+	LaosEstimator();
+	void Reset();
+	// the head is at x,y [mm] (without moving)
+	void SetPosition(float x, float y);
+	// move to x,y [mm] at feedrate [mm/min] with acceleration [mm/sec2]
+	void Move(float x, float y, float feedrate, float acceleration);
+	// wait until all moves are done
+	void Flush();
+	// estimated time of the moves that are done [sec]
+	float Time() const { return m_Time; }
+	// nr of times the head came to a full stop
+	unsigned long Stops() const { return m_Stops; }
+
+private:
+	typedef struct {
+		float millimeters;      // length of the move [mm]
+		float nominal_speed;    // [mm/min]
+		float entry_speed;      // planned speed at the start [mm/min]
+		float max_entry_speed;  // junction speed limit [mm/min]
+		float acceleration;     // [mm/sec2]
+		bool nominal_length_flag;
+	} TBlock;
+	void Recalculate();
+	void Retire();
+
+private:
+	TBlock m_Block[ESTIMATOR_BLOCKS]; // look ahead window, [0] is executed first
+	int m_Count;
+	float m_X, m_Y;                     // position [mm]
+	bool m_HasPosition;                 // false until the position is known
+	float m_PrevUnitVec[NUM_AXES];      // direction of the last move
+	float m_PrevNominalSpeed;           // speed of the last move [mm/min]
+	float m_Time;                       // [sec]
+	unsigned long m_Stops;
+};
+
+#endif
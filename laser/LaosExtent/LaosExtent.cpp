@@ -24,6 +24,13 @@
 
 #include "LaosExtent.h"
 #include "LaosMotion.h"
+#include <math.h>
+
+// direction vectors of the outline points (times 256, 22.5 degrees apart)
+static const short s_OutlineDir[EXTENT_OUTLINE_POINTS][2] = {
+	{256, 0}, {237, 98}, {181, 181}, {98, 237}, {0, 256}, {-98, 237}, {-181, 181}, {-237, 98},
+	{-256, 0}, {-237, -98}, {-181, -181}, {-98, -237}, {0, -256}, {98, -237}, {181, -181}, {237, -98}
+};
 
 LaosExtent::LaosExtent()
 {
@@ -35,52 +42,240 @@ LaosExtent::LaosExtent()
 //   if false, will also take into account moves without the laser on
 void LaosExtent::Reset(bool onlyMovesWithLaserOn)
 {
-	m_MinX=0;
-	m_MaxX=0;
-	m_MinY=0;
-	m_MaxY=0;
-	m_HasMinMaxCoordinates=false;
-	m_Error=errNone;
+	extern GlobalConfig *cfg;
+	memset(&m_Summary, 0, sizeof(m_Summary));
+	m_Summary.Error=errNone;
+	m_HasLast=false;
+	m_ShiftX=m_ShiftY=0;
+	m_Estimator.Reset();
+	m_MovePending=false;
+	if(cfg != NULL) // the menu creates its LaosExtent before the config is read
+	{
+		m_MarkSpeed=cfg->speed;
+		m_BitmapSpeed=cfg->xspeed;
+	}
+	m_BitmapPending=false;
+	m_BitmapWidth=0;
+	m_BitmapDir=false;
+	m_BitmapStream=false;
+	m_BitmapFirst=m_BitmapLast=-1;
 	m_Step=0;
 	m_Command=0;
   m_OnlyMovesWithLaserOn=onlyMovesWithLaserOn;
 }
 
-void LaosExtent::AddToBoundary(int x, int y)
+// box 0: all moves, box 1: only moves with the laser on
+void LaosExtent::AddToBoundary(int box, int x, int y)
+{
+	TExtentSummary &s = m_Summary;
+	if(box == 1) AddToOutline(x, y);
+	if(!s.Valid[box])
+	{
+		// this is the first coordinate of this box:
+		s.MinX[box]=x;
+		s.MinY[box]=y;
+		s.MaxX[box]=x;
+		s.MaxY[box]=y;
+	}
+	if(x < s.MinX[box]) s.MinX[box]=x;
+	if(y < s.MinY[box]) s.MinY[box]=y;
+	if(x > s.MaxX[box]) s.MaxX[box]=x;
+	if(y > s.MaxY[box]) s.MaxY[box]=y;
+	s.Valid[box]=true;
+}
+
+// count the move to the current target
+void LaosExtent::AddLength(bool laserOn)
+{
+	m_Summary.Segments++;
+	if(m_HasLast)
+	{
+		float dx = (m_TargetX - m_LastX) / 1000.0;
+		float dy = (m_TargetY - m_LastY) / 1000.0;
+		float len = sqrtf(dx*dx + dy*dy);
+		m_Summary.PathLength += len;
+		if(laserOn) m_Summary.LaserLength += len;
+	}
+	m_LastX = m_TargetX;
+	m_LastY = m_TargetY;
+	m_HasLast = true;
+}
+
+// keep the laser on point that is furthest out in each direction, the outline
+// is built from the lines through these points (see GetOutline)
+void LaosExtent::AddToOutline(int x, int y)
+{
+	TExtentSummary &s = m_Summary;
+	for(int i=0; i < EXTENT_OUTLINE_POINTS; i++)
+	{
+		int dx = s_OutlineDir[i][0], dy = s_OutlineDir[i][1];
+		if( (!s.Valid[1]) || (x*dx + y*dy > s.OutlineX[i]*dx + s.OutlineY[i]*dy) )
+		{
+			s.OutlineX[i] = x;
+			s.OutlineY[i] = y;
+		}
+	}
+}
+
+// bit n of the row is pixel n, a set bit is laser on (see stepper.cpp)
+void LaosExtent::ScanBitmapWord(unsigned long word, int base)
+{
+	for(int bit=0; word && (bit < 32); bit++, word >>= 1)
+	{
+		if( (word & 1) && (base+bit < m_BitmapWidth) )
+		{
+			if(m_BitmapFirst < 0) m_BitmapFirst = base+bit;
+			m_BitmapLast = base+bit;
+		}
+	}
+}
+
+// a streamed bitmap line is complete: it is not trimmed, LaosMotion plays
+// the row in the order it is sent
+void LaosExtent::AddStreamLine()
+{
+	extern GlobalConfig *cfg;
+	AddToBoundary(0, m_TargetX, m_TargetY);
+	AddBitmapLine();
+	AddLength(true);
+	FlushMove();
+	m_Estimator.Flush();
+	m_Estimator.Move(m_TargetX/1000.0, m_TargetY/1000.0, 60*m_BitmapSpeed, cfg->xaccel);
+	m_Estimator.Flush();
+	m_BitmapStream = false;
+}
+
+// first and last pixel that is on of the current bitmap line, in the
+// order of the line. Returns false if the row is blank
+bool LaosExtent::GetBitmapSpan(int &first, int &last) const
+{
+	if(m_BitmapFirst < 0) return false;
+	first = m_BitmapFirst;
+	last = m_BitmapLast;
+	if(m_BitmapDir && !m_BitmapStream && (m_TargetX < m_LastX))
+	{
+		// the row is in +x order, the stepper reads it from the end
+		first = m_BitmapWidth - 1 - m_BitmapLast;
+		last = m_BitmapWidth - 1 - m_BitmapFirst;
+	}
+	return true;
+}
+
+// a bitmap line only burns from the first to the last pixel that is on
+// (the stepper spreads the width pixels evenly over the line)
+void LaosExtent::AddBitmapLine()
+{
+	int first, last;
+	if(!m_HasLast || !GetBitmapSpan(first, last)) return;
+	float dx = (float)(m_TargetX - m_LastX) / m_BitmapWidth;
+	float dy = (float)(m_TargetY - m_LastY) / m_BitmapWidth;
+	AddToBoundary(1, m_LastX + (int)(dx*first), m_LastY + (int)(dy*first));
+	AddToBoundary(1, m_LastX + (int)(dx*(last+1)), m_LastY + (int)(dy*(last+1)));
+}
+
+// time of a bitmap line, as queued by LaosMotion::bitmapLine(): a blank
+// row is a move, blank pixels at the ends are moved over except the overscan.
+// The time saved is counted against playing the whole row at the bitmap speed
+void LaosExtent::EstimateBitmapLine()
+{
+	extern GlobalConfig *cfg;
+	int first, last;
+	float x0 = m_LastX/1000.0, y0 = m_LastY/1000.0;
+	float x1 = m_TargetX/1000.0, y1 = m_TargetY/1000.0;
+	float dx = x1 - x0, dy = y1 - y0;
+	float len = sqrtf(dx*dx + dy*dy);
+	float skip = 1.0/m_BitmapSpeed - 1.0/cfg->speed; // time saved per mm that is moved over
+	int width = m_BitmapWidth;
+	if(!m_HasLast)
+	{
+		m_Estimator.Move(x1, y1, 60*cfg->speed, cfg->accel);
+		return;
+	}
+	if((len <= 0) || !GetBitmapSpan(first, last))
+	{
+		DeferMove(x0, y0, x1, y1);
+		m_Summary.SavedTime += len * skip;
+		return;
+	}
+	int overscan = (int)((float)m_BitmapSpeed*m_BitmapSpeed / (2.0*cfg->xaccel) * width / len) + 1;
+	int start = first - overscan, end = last + 1 + overscan;
+	if(start < 0) start = 0;
+	if(end > width) end = width;
+	if(start > 0)
+		DeferMove(x0, y0, x0 + dx*start/width, y0 + dy*start/width);
+	FlushMove();
+	m_Estimator.Flush(); // LaosMotion waits for the queue before and after a bitmap line
+	m_Estimator.Move(x0 + dx*end/width, y0 + dy*end/width, 60*m_BitmapSpeed, cfg->xaccel);
+	m_Estimator.Flush();
+	if(end < width)
+		DeferMove(x0 + dx*end/width, y0 + dy*end/width, x1, y1);
+	m_Summary.SavedTime += len * (start + width - end) / width * skip;
+}
+
+// a move from x0,y0 to x,y [mm] with the laser off: LaosMotion holds it back
+// and joins it with the moves that follow into one straight move
+void LaosExtent::DeferMove(float x0, float y0, float x, float y)
 {
-	if(!m_HasMinMaxCoordinates)
+	if(!m_MovePending)
 	{
-		// this is the first coordinate where the laser goes on:
-		m_MinX=x;
-		m_MinY=y;
-		m_MaxX=x;
-		m_MaxY=y;
+		m_MoveFromX = x0;
+		m_MoveFromY = y0;
+		m_MoveLength = 0;
+		m_MovePending = true;
 	}
-	if(x < m_MinX) m_MinX=x;
-	if(y < m_MinY) m_MinY=y;
-	if(x > m_MaxX) m_MaxX=x;
-	if(y > m_MaxY) m_MaxY=y;
-	m_HasMinMaxCoordinates=true;
+	m_MoveLength += sqrtf((x-x0)*(x-x0) + (y-y0)*(y-y0));
+	m_MoveX = x;
+	m_MoveY = y;
+}
+
+// something else than a move follows: plan the joined moves
+void LaosExtent::FlushMove()
+{
+	extern GlobalConfig *cfg;
+	if(!m_MovePending) return;
+	float dx = m_MoveX - m_MoveFromX, dy = m_MoveY - m_MoveFromY;
+	m_Estimator.Move(m_MoveX, m_MoveY, 60*cfg->speed, cfg->accel);
+	m_Summary.SavedTime += (m_MoveLength - sqrtf(dx*dx + dy*dy)) / cfg->speed;
+	m_MovePending = false;
 }
 
 LaosExtent::TError LaosExtent::GetBoundary(int &minx, int &miny, int &maxx, int &maxy) const
 {
-	minx=m_MinX;
-	miny=m_MinY;
-	maxx=m_MaxX;
-	maxy=m_MaxY;
-	if( (!m_Error) && (!m_HasMinMaxCoordinates))
+	int box = m_OnlyMovesWithLaserOn ? 1 : 0;
+	minx=m_Summary.MinX[box];
+	miny=m_Summary.MinY[box];
+	maxx=m_Summary.MaxX[box];
+	maxy=m_Summary.MaxY[box];
+	if( (!m_Summary.Error) && (!m_Summary.Valid[box]))
 	{
 		return errEmpty;
 	}
 	else
 	{
-		return m_Error;
+		return (TError)m_Summary.Error;
 	}
 }
+
+void LaosExtent::GetSummary(TExtentSummary &summary) const
+{
+	LaosExtent extent = *this; // finish the moves that are still held back or queued
+	extent.FlushMove();
+	extent.m_Estimator.Flush();
+	summary = extent.m_Summary;
+	summary.Time = extent.m_Estimator.Time();
+	summary.Stops = extent.m_Estimator.Stops();
+}
+
+// restore the result of an earlier pass (the file is not read)
+void LaosExtent::SetSummary(const TExtentSummary &summary)
+{
+	m_Summary = summary;
+	m_Step = 0;
+}
 // Feed simplecode
 void LaosExtent::Write(int i)
 {
+  extern GlobalConfig *cfg;
 //  	printf(">%i (command: %i, step: %i)\n",i,m_Command,m_Step);
 
   if ( m_Step == 0 )
@@ -97,19 +292,43 @@ void LaosExtent::Write(int i)
             switch ( m_Step )
             {
               case 1:
-                if(m_Command == 1) // ignore moves with the laser off
-                {
-                	// add previous endpoint to the extent:
-                	AddToBoundary(m_TargetX, m_TargetY);
-                }
-                m_TargetX = i;
+                m_TargetX = i + m_ShiftX;
                 break;
               case 2:
-                m_TargetY = i;
+                m_TargetY = i + m_ShiftY;
                 m_Step=0;
-                if( (!m_OnlyMovesWithLaserOn) || (m_Command == 1) )
+                AddToBoundary(0, m_TargetX, m_TargetY);
+                if(m_BitmapPending && (m_Command == 1))
+                {
+                	AddBitmapLine();
+                }
+                else if(m_Command == 1) // ignore moves with the laser off
+                {
+                	// add previous endpoint to the extent:
+                	if(m_HasLast) AddToBoundary(1, m_LastX, m_LastY);
+                	AddToBoundary(1, m_TargetX, m_TargetY);
+                }
+                if(m_BitmapPending && (m_Command == 1))
+                {
+                	EstimateBitmapLine();
+                	AddLength(true);
+                	m_BitmapPending=false;
+                }
+                else if(m_Command == 1)
+                {
+                	FlushMove();
+                	AddLength(true);
+                	m_Estimator.Move(m_TargetX/1000.0, m_TargetY/1000.0, 60*m_MarkSpeed, cfg->accel);
+                }
+                else if(m_HasLast)
                 {
-                	AddToBoundary(m_TargetX, m_TargetY);
+                	DeferMove(m_LastX/1000.0, m_LastY/1000.0, m_TargetX/1000.0, m_TargetY/1000.0);
+                	AddLength(false);
+                }
+                else
+                {
+                	AddLength(false);
+                	m_Estimator.Move(m_TargetX/1000.0, m_TargetY/1000.0, 60*cfg->speed, cfg->accel);
                 }
                 break;
             }
@@ -119,16 +338,43 @@ void LaosExtent::Write(int i)
           	if(m_Step == 1) m_Step=0;
             break;
          case 4: // set x,y,z (absolute)
-         	// Not supported
-         	if(!m_Error) m_Error = errCoordReferenceChanged;
-          	if(m_Step == 3) m_Step=0;
+         	if(m_Step == 1) m_SetX=i;
+         	if(m_Step == 2) m_SetY=i;
+          	if(m_Step == 3)
+          	{
+          		// the head does not move, it gets new coordinates (like
+          		// LaosMotion::setPositionRelativeToOrigin()): from now on the
+          		// coordinates in the file are offset from where the head is.
+          		// Before the first move that position is not known.
+          		if(m_HasLast)
+          		{
+          			m_ShiftX = m_LastX - m_SetX;
+          			m_ShiftY = m_LastY - m_SetY;
+          		}
+          		else if(!m_Summary.Error)
+          		{
+          			m_Summary.Error = errCoordReferenceChanged;
+          		}
+          		m_Step=0;
+          	}
             break;
          case 5: // nop
            m_Step = 0;
            break;
          case 7: // set index,value
-         	// ignored
-          	if(m_Step == 2) m_Step=0;
+         	if(m_Step == 1) m_Param=i;
+          	if(m_Step == 2)
+          	{
+          		if(m_Param == 100) // speed, as in LaosMotion::write()
+          		{
+          			if(i < 1) i = 1;
+          			if(i > 9999) i = 10000;
+          			m_MarkSpeed = i * cfg->speed / 10000;
+          			m_BitmapSpeed = i * cfg->xspeed / 10000;
+          		}
+          		if(m_Param == 102) m_BitmapDir = (i != 0);
+          		m_Step=0;
+          	}
           	break;
          case 9: // Store bitmap mark data format: 9 <bpp> <width> <data-0> <data-1> ... <data-n>
             if ( m_Step == 1 )
@@ -140,18 +386,80 @@ void LaosExtent::Write(int i)
               m_BitmapSize = (m_BitmapBpp * i) / 32;
               if  ( (m_BitmapBpp * i) % 32 )  // padd to next 32-bit
                 m_BitmapSize++;
+              m_BitmapWidth = i;
+              m_BitmapFirst = m_BitmapLast = -1;
+              m_Estimator.Flush();
+              m_BitmapPending=true;
 
             }
             else if ( m_Step > 2 ) // bitmap data
             {
+              ScanBitmapWord(i, (m_Step-3)*32);
 			  if ( m_Step-2 == m_BitmapSize ) // last dword received
               {
                 m_Step = 0;
               }
             }
             break;
+         case 10: // run length coded bitmap: 10 <width> <nr of runs> <run-0> ... <run-n>
+            if ( m_Step == 1 )
+            {
+              m_BitmapWidth = i;
+              m_BitmapFirst = m_BitmapLast = -1;
+              m_Estimator.Flush();
+              m_BitmapPending=true;
+            }
+            else if ( m_Step == 2 )
+            {
+              m_BitmapSize = i; // nr of runs
+              m_BitmapPos = 0;
+              if ( m_BitmapSize <= 0 ) m_Step = 0;
+            }
+            else
+            {
+              // runs alternate between laser off and on, starting with off
+              int end = m_BitmapPos + (i > 0 ? i : 0);
+              if ( end > m_BitmapWidth ) end = m_BitmapWidth;
+              if ( ((m_Step-3) & 1) && (end > m_BitmapPos) )
+              {
+                if(m_BitmapFirst < 0) m_BitmapFirst = m_BitmapPos;
+                m_BitmapLast = end-1;
+              }
+              if ( end > m_BitmapPos ) m_BitmapPos = end;
+              if ( m_Step-2 == m_BitmapSize ) // last run received
+              {
+                m_Step = 0;
+              }
+            }
+            break;
+         case 11: // streamed bitmap line: 11 <x> <y> <bpp> <width> <data-0> ... <data-n>
+            if ( m_Step == 1 ) m_TargetX = i + m_ShiftX;
+            else if ( m_Step == 2 ) m_TargetY = i + m_ShiftY;
+            else if ( m_Step == 3 ) m_BitmapBpp = i;
+            else if ( m_Step == 4 )
+            {
+              m_BitmapSize = (m_BitmapBpp * i + 31) / 32;
+              m_BitmapWidth = i;
+              m_BitmapFirst = m_BitmapLast = -1;
+              m_BitmapStream = true;
+              if ( m_BitmapSize <= 0 )
+              {
+                AddStreamLine();
+                m_Step = 0;
+              }
+            }
+            else // bitmap data
+            {
+              ScanBitmapWord(i, (m_Step-5)*32);
+              if ( m_Step-4 == m_BitmapSize ) // last dword received
+              {
+                AddStreamLine();
+                m_Step = 0;
+              }
+            }
+            break;
          default: // I do not understand:
-         	//if(!m_Error) m_Error = errFileFormatError;
+         	//if(!m_Summary.Error) m_Summary.Error = errFileFormatError;
             m_Step = 0;
             break;
     }
@@ -160,9 +468,86 @@ void LaosExtent::Write(int i)
   }
 }
 
+// corner where the supporting lines of direction i and j meet, the lines are
+// dir . p = h (dir times 256), j is less than 180 degrees counter clockwise of i
+static void corner(int i, int j, const float *h, float &x, float &y)
+{
+	float a1 = s_OutlineDir[i][0], b1 = s_OutlineDir[i][1];
+	float a2 = s_OutlineDir[j][0], b2 = s_OutlineDir[j][1];
+	float det = a1*b2 - a2*b1;
+	x = (h[i]*b2 - h[j]*b1) / det;
+	y = (a1*h[j] - a2*h[i]) / det;
+}
+
+// The outline is the polygon of the supporting lines through the outermost
+// point in each direction, so all laser on points are inside it. Its corners
+// are where the lines of neighbouring directions meet.
+int LaosExtent::GetOutline(int *x, int *y) const
+{
+	float h[EXTENT_OUTLINE_POINTS];
+	int line[EXTENT_OUTLINE_POINTS]; // directions of the lines that are kept
+	int n = EXTENT_OUTLINE_POINTS;
+	if( m_Summary.Error || (!m_Summary.Valid[1]) ) return 0;
+	for(int i=0; i < n; i++)
+	{
+		line[i] = i;
+		h[i] = (float)m_Summary.OutlineX[i]*s_OutlineDir[i][0] + (float)m_Summary.OutlineY[i]*s_OutlineDir[i][1];
+	}
+	// leave out the lines that hardly change the outline: without a line its
+	// two corners are replaced by the corner of the lines next to it, further
+	// out. Lines next to each other stay less than 90 degrees apart.
+	bool dropped = true;
+	while(dropped)
+	{
+		dropped = false;
+		for(int i=0; (i < n) && (n > 4); i++)
+		{
+			int prev = line[(i+n-1) % n], next = line[(i+1) % n];
+			if( (next - prev + EXTENT_OUTLINE_POINTS) % EXTENT_OUTLINE_POINTS > EXTENT_OUTLINE_POINTS/4 ) continue;
+			float cx, cy;
+			corner(prev, next, h, cx, cy);
+			int d = line[i];
+			float grow = (cx*s_OutlineDir[d][0] + cy*s_OutlineDir[d][1] - h[d]) / 256;
+			if(grow > EXTENT_OUTLINE_TOLERANCE) continue;
+			memmove(&line[i], &line[i+1], (n-i-1) * sizeof(int));
+			n--;
+			dropped = true;
+		}
+	}
+	int count = 0;
+	for(int i=0; i < n; i++)
+	{
+		float cx, cy;
+		corner(line[i], line[(i+1) % n], h, cx, cy);
+		int px = (int)floorf(cx + 0.5f), py = (int)floorf(cy + 0.5f);
+		// lines through the same point meet in the same corner, drop the doubles:
+		if( (count > 0) && (px == x[count-1]) && (py == y[count-1]) ) continue;
+		if( (count > 0) && (px == x[0]) && (py == y[0]) ) continue;
+		x[count] = px;
+		y[count] = py;
+		count++;
+	}
+	return count;
+}
+
+void LaosExtent::ShowOutline(LaosMotion *mot) const
+{
+	int x[EXTENT_OUTLINE_POINTS], y[EXTENT_OUTLINE_POINTS];
+	int n = GetOutline(x, y);
+	if(n == 0) return;
+	int dummy1, dummy2, z;
+	mot->getPlannedPositionRelativeToOrigin(&dummy1, &dummy2, &z);
+	// all moves are queued at once: the planner keeps the speed up at the corners
+	for(int i=0; i <= n; i++)
+	{
+		mot->moveToRelativeToOrigin(x[i % n], y[i % n], z);
+	}
+}
+
 void LaosExtent::ShowBoundaries(LaosMotion *mot) const
 {
-	if( (!m_Error) && (m_HasMinMaxCoordinates))
+	int minx, miny, maxx, maxy;
+	if(GetBoundary(minx, miny, maxx, maxy) == errNone)
 	{
 		int dummy1, dummy2, z;
     mot->getPlannedPositionRelativeToOrigin(&dummy1, &dummy2, &z);
@@ -172,19 +557,19 @@ void LaosExtent::ShowBoundaries(LaosMotion *mot) const
       // start in bottom right corner, then go counter clockwise:
 			if( (step == 1)||(step == 2) )
 			{
-				y=m_MaxY;
+				y=maxy;
 			}
 			else
 			{
-				y=m_MinY;
+				y=miny;
 			}
 			if( (step == 2)||(step ==3) )
 			{
-				x=m_MinX;
+				x=minx;
 			}
 			else
 			{
-				x=m_MaxX;
+				x=maxx;
 			}
 			while(mot->queue()) {} // wait until motion is done
 			if(step == 1)
@@ -4,10 +4,28 @@
 #include "global.h"
 #include "pins.h"
 #include "planner.h"
+#include "LaosEstimator.h"
 
 // forward decls:
 class LaosMotion;
 
+#define EXTENT_OUTLINE_POINTS 16      // directions of the outline around the laser on area
+#define EXTENT_OUTLINE_TOLERANCE 500  // a corner is left out if the outline grows less than this [um]
+
+// Result of the analysis of a job (as stored in the job index)
+typedef struct {
+	int MinX[2], MinY[2], MaxX[2], MaxY[2]; // [0]: all moves, [1]: only moves with the laser on
+	unsigned char Valid[2];     // the box has coordinates
+	unsigned char Error;        // LaosExtent::TError
+	unsigned long Segments;     // nr of moves and lines
+	float PathLength;           // length of all moves and lines [mm]
+	float LaserLength;          // length of the lines with the laser on [mm]
+	float Time;                 // estimated run time [sec]
+	unsigned long Stops;        // nr of full stops of the head
+	float SavedTime;            // time saved by skipping blank pixels and joining moves [sec]
+	int OutlineX[EXTENT_OUTLINE_POINTS], OutlineY[EXTENT_OUTLINE_POINTS]; // outermost laser on point per direction
+} TExtentSummary;
+
     /** Get the minimum and maximum coordinates of a given file
       *
       * Example:
@@ -26,20 +44,51 @@ public:
 	TError GetBoundary(int &minx, int &miny, int &maxx, int &maxy) const;
 	// show boundaries by moving the head:
 	void ShowBoundaries(LaosMotion *mot) const;
+	// trace the outline of the laser on area with the laser off:
+	void ShowOutline(LaosMotion *mot) const;
+	// the outline as a convex polygon around the laser on area, returns the nr of points
+	int GetOutline(int *x, int *y) const;
+	// both boundaries and the job statistics, to store or restore the result
+	void GetSummary(TExtentSummary &summary) const;
+	void SetSummary(const TExtentSummary &summary);
 
 private:
-	void AddToBoundary(int x, int y);
+	void AddToBoundary(int box, int x, int y);
+	void AddLength(bool laserOn);
+	bool GetBitmapSpan(int &first, int &last) const;
+	void AddBitmapLine();
+	void ScanBitmapWord(unsigned long word, int base);
+	void AddStreamLine();
+	void EstimateBitmapLine();
+	void DeferMove(float x0, float y0, float x, float y);
+	void FlushMove();
+	void AddToOutline(int x, int y);
 
 private:
-	int m_MinX, m_MaxX, m_MinY, m_MaxY;  // boundaries (multiplied by 1000)
-	bool m_HasMinMaxCoordinates;         // initially false; will be set true once the laser fires
+	TExtentSummary m_Summary;            // boundaries (multiplied by 1000) and statistics
 	int m_TargetX, m_TargetY;            // target pos of current command
+	int m_LastX, m_LastY;                // end of the previous move
+	bool m_HasLast;                      // false until the first move is read
+	int m_SetX, m_SetY;                  // arguments of the set position command
+	int m_ShiftX, m_ShiftY;              // offset of the file coordinates after a set position
+	int m_Param;                         // index of the set index,value command
+	LaosEstimator m_Estimator;           // run time estimate
+	bool m_MovePending;                  // a move is held back to join the next one (as LaosMotion does)
+	float m_MoveFromX, m_MoveFromY;      // start of the joined moves [mm]
+	float m_MoveX, m_MoveY;              // target of the joined moves [mm]
+	float m_MoveLength;                  // length of the joined moves [mm]
+	int m_MarkSpeed, m_BitmapSpeed;      // speed of lines and bitmap lines [mm/sec]
+	bool m_BitmapPending;                // the next line is a bitmap line
 	int m_BitmapSize;
+	int m_BitmapWidth;                   // nr of pixels in the bitmap line
+	int m_BitmapFirst, m_BitmapLast;     // first and last pixel that is on (-1: none)
+	bool m_BitmapDir;                    // rows are in +x order (set index 102)
+	int m_BitmapPos;                     // pixels of the run length coded row so far
+	bool m_BitmapStream;                 // reading a streamed bitmap line (command 11)
 	int m_BitmapBpp;
 	int m_Step;
 	int m_Command;
 	bool m_OnlyMovesWithLaserOn;
-	TError m_Error;
 };
 
 #endif
@@ -1,7 +1,7 @@
 /*
  *
  * LaosFilesystem.cpp
- * Simple Long Filename system on top of SDFilesystem.h
+ * Long filename helpers on top of SDFilesystem.h
  *
  * Copyright (c) 2011 Jaap Vermaas
  *
@@ -22,62 +22,31 @@
  *
  */
 #include "laosfilesystem.h"
+#include "laosjobindex.h"
 
 LaosFileSystem::LaosFileSystem(PinName mosi, PinName miso, PinName sclk, PinName cs, const char* name)
         : SDFileSystem(mosi, miso, sclk, cs, name) {
     sprintf(tablename, "/%s/%s", name, _LAOSFILE_TRANSTABLE);
     sprintf(pathname, "/%s/", name);
+    jobs = NULL;
+    njobs = jobsize = 0;
+    jobsloaded = false;
 }
 
 LaosFileSystem::~LaosFileSystem() {
+    delete[] jobs;
 }
 
 FILE* LaosFileSystem::openfile(char *name, const std::string& iom) {
     if (islegalname(name)) {  // check length and chars in name
-
-        char shortname[SHORTFILESIZE] = "";
-        getshortname(shortname, name);
         char fullname[MAXFILESIZE+SHORTFILESIZE+1];
-        if (strstr(iom.c_str(), "r")) {        // open file for reading
-            if (strlen(shortname)!=0) {
-                sprintf(fullname, "%s%s", pathname, shortname);
-                return fopen(fullname, iom.c_str());
-            } else {                // no file exists
-                return NULL;
-            }
-        } else {                    // open file for writng
-            if (strlen(shortname)!=0) {
-                sprintf(fullname, "%s%s", pathname, shortname);
-                return fopen(fullname, iom.c_str());
-            } else {                    // create a new file
-                makeshortname(shortname, name);
-                sprintf(fullname, "%s%s", pathname, shortname);
-                return fopen(fullname, iom.c_str());
-            }
-        }
+        sprintf(fullname, "%s%s", pathname, name);
+        return fopen(fullname, iom.c_str());
     } else {    // (islegalname(name))
         return NULL;
     }
 }
 
-void LaosFileSystem::getlongname(char *result, char *searchname) {
-    FILE *fp = fopen(tablename, "r");
-    if (fp) {
-        char longname[MAXFILESIZE];
-        char shortname[SHORTFILESIZE];
-        while (dirread(longname, shortname, fp))
-            if (! strcmp(shortname, searchname))
-                break;
-        if (strcmp(shortname, searchname))
-            strcpy(result, searchname);
-        else
-            strcpy(result, longname);
-        fclose(fp);
-    } else {
-        strcpy(result, searchname);
-    }
-}
-
 int LaosFileSystem::islegalname(char* name) {
     if (( strlen(name) > MAXFILESIZE-1 ) || (strlen(name) == 0))
         return 0;
@@ -94,140 +63,139 @@ int LaosFileSystem::islegalname(char* name) {
     return legal;
 }
 
-int LaosFileSystem::isshortname(char* name) {
-    unsigned int len = strlen(name);
-    for (unsigned int x=0; x<len; x++)
-        if (name[x] == ' ') return 0; // spaces not allowed in shortname
-
-    char myname[MAXFILESIZE];
-    strcpy(myname, name);
-    char *basename = NULL;
-    if (len <= SHORTFILESIZE-1) {
-        basename = strtok(myname, ".");
-        if (strlen(basename) > 8) {
-            return 0;    // basename was too long
-        } else {
-            if (char *ext_name = strtok(NULL, ".")) {  //
-                if ((strlen(basename)+strlen(ext_name)+1) == len) {
-                    if (strlen(ext_name)<4) {
-                        return 1; // filename is in 8.3 format
-                    } else {
-                        return 0; // extension too long
-                    }
-                } else {
-                    return 0; // there was more then one dot
-                }
-            } else {
-                return 1; // filename of max 8 chars, no extension (OK)
-            }
-        }
-    } else {
-        return 0; // total filename too long
+// Older firmware stored files under a generated 8.3 name and kept the
+// long names in longname.sys. Give those files their long name (FatFs
+// handles long names itself) and remove the table. Records are renamed
+// last to first, so a short name that was reused gets the newest name.
+void LaosFileSystem::migrate() {
+    FILE *fp = fopen(tablename, "rb");
+    if (fp == NULL) return;
+    printf("Converting %s...\n\r", _LAOSFILE_TRANSTABLE);
+    fseek(fp, 0, SEEK_END);
+    long records = ftell(fp) / (MAXFILESIZE+SHORTFILESIZE);
+    while (records-- > 0) {
+        char longname[MAXFILESIZE];
+        char shortname[SHORTFILESIZE];
+        char oldname[MAXFILESIZE+SHORTFILESIZE+1];
+        char newname[MAXFILESIZE+SHORTFILESIZE+1];
+        fseek(fp, records * (MAXFILESIZE+SHORTFILESIZE), SEEK_SET);
+        if (! dirread(longname, shortname, fp))
+            break;
+        sprintf(oldname, "%s%s", pathname, shortname);
+        sprintf(newname, "%s%s", pathname, longname);
+        ::rename(oldname, newname);     // fails for stale records, ignore
     }
+    fclose(fp);
+    ::remove(tablename);
 }
 
-void LaosFileSystem::removespaces(char* name) {
-    unsigned int spaces = 1;
-    while (spaces) {
-        spaces = 0;
-        unsigned int x = 0;
-        while ((name[x] != ' ') && (x<strlen(name))) x++;
-        if (name[x] == ' ') {
-            spaces = 1;
-            for (int y = x; x<(strlen(name)-1); y++)
-                name[y] = name[y+1];
-        }
+// The job list holds all files in the root directory, sorted by name
+// (case insensitive). It is read once from the card, after that
+// addjob() and deljob() keep it in sync with uploads and removals.
+void LaosFileSystem::scanjobs() {
+    FATFS_DIR dir;
+    FILINFO finfo;
+    char lfn[_MAX_LFN+1];
+    finfo.lfname = lfn;
+    finfo.lfsize = sizeof(lfn);
+    njobs = 0;
+    jobsloaded = true;
+    if (f_opendir(&dir, "") != FR_OK) {
+        printf("scanjobs: Could not open directory!\n\r");
+        return;
+    }
+    while ((f_readdir(&dir, &finfo) == FR_OK) && (finfo.fname[0] != 0)) {
+        char *name = lfn[0] ? lfn : finfo.fname;
+        if (!(finfo.fattrib & AM_DIR) && (strlen(name) < MAXFILESIZE) &&
+                (strcasecmp(name, _LAOSFILE_JOBINDEX) != 0) &&
+                (strcasecmp(name, _LAOSFILE_OPTIMIZE) != 0) &&
+                (strcasecmp(name, _LAOSFILE_REPLACED) != 0))
+            insertjob(name, &finfo);
     }
 }
 
-void LaosFileSystem::getshortname(char* shortname, char* name) {
-    // * open filename translation table
-    // * and see if a file with that name exists
-    if (isshortname(name)) {
-        strcpy(shortname, name);
-    } else {
-        int found = 0;
-        char longname[MAXFILESIZE];
-        FILE *fp = fopen(tablename, "r");
-        if (fp) {
-            while (dirread(longname, shortname, fp)) {
-                if (!strcmp(longname, name)) {
-                    found = 1;
-                    break;
-                }
-            }
-            if (! found) strcpy(shortname, "");
-            fclose(fp);
-        }
+void LaosFileSystem::addjob(char* name) {
+    if (!jobsloaded) {
+        scanjobs();
+        return;
     }
+    FILINFO finfo;
+    finfo.lfname = NULL;
+    finfo.lfsize = 0;
+    if (f_stat(name, &finfo) == FR_OK)
+        insertjob(name, &finfo);
+    else
+        deljob(name);
 }
 
-void LaosFileSystem::makeshortname(char* shortname, char* name) {
-    char *tmpname = new char[MAXFILESIZE];
-    strcpy(tmpname, name);
-    removespaces(tmpname);
-    shorten(tmpname, SHORTFILESIZE);
-    char *basename = strtok(tmpname, ".");
-    char *ext_name = strtok(NULL, ".");
-    strtolower(basename);
-    strtolower(ext_name);
-    int cnt = 1;
-    char fullname[MAXFILESIZE+SHORTFILESIZE+2];
-    FILE *fp = NULL;
-    do {
-        if (fp != NULL) fclose(fp);
-        while ((cnt/10+strlen(basename)+2) > 8)
-            basename[strlen(basename)-1] = 0;
-        if (strlen(ext_name) > 0) {
-            sprintf(shortname, "%s~%d.%s", basename, cnt++, ext_name);
-        } else {
-            sprintf(shortname, "%s~%d", basename, cnt++);
-        }
-        sprintf(fullname, "%s%s", pathname, shortname);
-        fp = fopen(fullname, "rb");
-    } while (fp!=NULL);
-    
-    FILE *tfp = fopen(tablename, "ab");
-    dirwrite(name, shortname, tfp);
-    fclose(tfp);
+void LaosFileSystem::deljob(char* name) {
+    int n;
+    if (jobsloaded && searchjob(name, &n)) {
+        memmove(&jobs[n], &jobs[n+1], (njobs-n-1)*sizeof(LaosJob));
+        njobs--;
+    }
+}
 
-    delete(tmpname);
+int LaosFileSystem::jobcount() {
+    if (!jobsloaded) scanjobs();
+    return njobs;
 }
 
-void LaosFileSystem::cleanlist() {
-    // * open filename translation table
-    char longname[MAXFILESIZE];
-    char shortname[SHORTFILESIZE];
-    char tabletmpname[MAXFILESIZE+SHORTFILESIZE+1];
-    strcpy (tabletmpname, tablename);
-    tabletmpname[strlen(tabletmpname)-1] = '~';
-    
-    // make a full copy of the table
-    FILE* fp1 = fopen(tablename, "rb");
-    if (fp1 == NULL) return;
-    FILE* fp2 = fopen(tabletmpname, "wb");
-    if (fp2 == NULL) return;
-    while (dirread(longname, shortname, fp1))
-        dirwrite(longname, shortname, fp2);
-    fclose(fp1);
-    fclose(fp2);
-
-    fp1 = fopen(tablename, "wb");
-    if (fp1 == NULL) return;
-    fp2 = fopen(tabletmpname, "rb");
-    if (fp2 == NULL) return;
-    FILE* fp;
-    while (dirread(longname, shortname, fp2)) {
-        char fullname[MAXFILESIZE+SHORTFILESIZE+1];
-        sprintf(fullname, "%s%s", pathname, shortname);
-        fp = fopen(fullname, "rb");
-        if (fp != NULL) {
-            fclose(fp);
-            dirwrite(longname, shortname, fp1);
-        } 
-     }
-     fclose(fp1);
-     fclose(fp2);
+int LaosFileSystem::findjob(char* name) {
+    int n;
+    if (!jobsloaded) scanjobs();
+    return searchjob(name, &n) ? n : -1;
+}
+
+LaosJob* LaosFileSystem::getjob(int n) {
+    if (!jobsloaded) scanjobs();
+    return ((n >= 0) && (n < njobs)) ? &jobs[n] : NULL;
+}
+
+static int jobcmp(const char* a, const char* b) {
+    while (*a && (tolower(*a) == tolower(*b))) {
+        a++;
+        b++;
+    }
+    return tolower(*a) - tolower(*b);
+}
+
+// binary search; returns 1 if found, pos is the (insert) position
+int LaosFileSystem::searchjob(const char* name, int* pos) {
+    int lo = 0, hi = njobs;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+        if (jobcmp(jobs[mid].name, name) < 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    *pos = lo;
+    return (lo < njobs) && (jobcmp(jobs[lo].name, name) == 0);
+}
+
+void LaosFileSystem::insertjob(const char* name, FILINFO* finfo) {
+    int n;
+    if (!searchjob(name, &n)) {
+        if (njobs == jobsize) {
+            short newsize = jobsize ? jobsize*2 : 16;
+            LaosJob *tmp = new LaosJob[newsize];
+            if (jobs != NULL) {
+                memcpy(tmp, jobs, njobs*sizeof(LaosJob));
+                delete[] jobs;
+            }
+            jobs = tmp;
+            jobsize = newsize;
+        }
+        memmove(&jobs[n+1], &jobs[n], (njobs-n)*sizeof(LaosJob));
+        njobs++;
+        jobs[n].indexrec = -1;
+    }
+    strncpy(jobs[n].name, name, MAXFILESIZE-1);
+    jobs[n].name[MAXFILESIZE-1] = 0;
+    jobs[n].size = finfo->fsize;
+    jobs[n].date = finfo->fdate;
+    jobs[n].time = finfo->ftime;
 }
 
 void LaosFileSystem::shorten(char* name, int max) {
@@ -266,25 +234,6 @@ size_t LaosFileSystem::dirread(char* longname, char* shortname, FILE *fp) {
     return result;
 }
 
-size_t LaosFileSystem::dirwrite(char* longname, char* shortname, FILE* fp) {
-    char buff[MAXFILESIZE+SHORTFILESIZE];
-    unsigned int x = 0; 
-    while (longname[x] != 0) {
-        buff[x] = longname[x];
-        x++;
-    }
-    while (x<MAXFILESIZE-1) buff[x++] = ' ';
-    buff[x++] = '\t';
-    while (shortname[x-MAXFILESIZE] != 0) {
-        buff[x] = shortname[x-MAXFILESIZE];
-        x++;
-    }
-    while (x<MAXFILESIZE+SHORTFILESIZE-1) buff[x++] = ' ';
-    buff[x++] = '\n';
-    
-    return fwrite(buff, 1, MAXFILESIZE+SHORTFILESIZE, fp);
-}
-
 void showfile() {
     char buff[35];
     FILE *fp = fopen("/sd/longname.sys","rb");
@@ -307,6 +256,9 @@ void cleandir() {
             sprintf(fullname, "/sd/%s", p->d_name);
             remove(fullname);
         }
+        closedir(d);
+        extern LaosFileSystem sd;
+        sd.scanjobs();
     } else {
         error("Could not open directory!\n\r");
     }
@@ -315,82 +267,35 @@ void cleandir() {
 void printdir() {
     extern LaosFileSystem sd;
     printf("List of files in /sd\n\r");
-    DIR *d;
-    struct dirent *p;
-    d = opendir("/sd");
-    if(d != NULL) {
-        // printf("...\n\r");
-        while((p = readdir(d)) != NULL) {
-            // printf("Short %s\n\r", p->d_name);
-            if (strncmp(p->d_name, "longname.sy",11)) {
-                char longname[MAXFILESIZE];
-                // printf("Getlongname\n\r");
-                sd.getlongname(longname, p->d_name);
-                printf(" - %s (short: %s)\n\r", longname, p->d_name);
-            }
-        }
-    } else {
-        printf("Could not open directory!\n\r");
-    }
+    for (int n=0; n<sd.jobcount(); n++)
+        printf(" - %s (%lu bytes)\n\r", sd.getjob(n)->name, sd.getjob(n)->size);
 }
 
 void getprevjob(char *name) {
     extern LaosFileSystem sd;
-    char shortname[SHORTFILESIZE], last[SHORTFILESIZE];
-    strcpy(last, "");
-    sd.getshortname(shortname, name);
-    DIR *d;
-    struct dirent *p;
-    d = opendir("/sd");
-    if(d != NULL) {
-        while((p = readdir(d)) != NULL) {
-            if (strncmp(p->d_name, "longname.sy",11)) { // skip longname.sy*
-                if (! strcmp(shortname, p->d_name)) {   // shortname = current entry
-                    if (strcmp(last, "")) {
-                        sd.getlongname(name, last);     // return entry before
-                    } else {
-                        sd.getlongname(name, p->d_name);    // last="", so current = first
-                    }
-                    closedir(d);
-                    return;
-                }
-                strcpy(last, p->d_name);
-            }
-        } // while
-        closedir(d);
-    } else {
-        printf("Getfilename: Could not open directory!\n\r");
-    }
-    sd.getlongname(name, last); // name not found (return last) 
-                                // or no file found (return "") 
+    int n = sd.findjob(name);
+    if (n < 0)
+        n = sd.jobcount()-1;    // name not found (return last)
+    else if (n > 0)
+        n--;                    // return entry before, first stays first
+    if (n < 0)
+        strcpy(name, "");       // no file found (return "")
+    else
+        strcpy(name, sd.getjob(n)->name);
 }
 
 void getnextjob(char *name) {
     extern LaosFileSystem sd;
-    char shortname[SHORTFILESIZE], last[SHORTFILESIZE];
-    strcpy(last, "");
-    sd.getshortname(shortname, name);
-    DIR *d;
-    struct dirent *p;
-    d = opendir("/sd");
-    if(d != NULL) {
-        while((p = readdir(d)) != NULL) {
-            if (strncmp(p->d_name, "longname.sy",11)) { // skip longname.sy*
-                if (! strcmp(shortname, last)) {        // if last was shortname
-                    sd.getlongname(name, p->d_name);    //    return current
-                    closedir(d);
-                    return;
-                }
-                strcpy(last, p->d_name);
-            }
-        } // while
-        closedir(d);
-    } else {
-        printf("Getfilename: Could not open directory!\n\r");
-    }
-    sd.getlongname(name, last);     // if last file was match, return the last
-                                    // if filename not found, return last
-                                    // if no file in directory, return ""
+    int n = sd.findjob(name);
+    if (n < 0)
+        n = strlen(name) ? sd.jobcount()-1 : 0; // not found (return last)
+                                                // no name (return first)
+    else if (n < sd.jobcount()-1)
+        n++;                    // return next, last stays last
+    if (n >= sd.jobcount())
+        strcpy(name, "");       // no file found (return "")
+    else
+        strcpy(name, sd.getjob(n)->name);
 }
 
 /*
@@ -455,61 +360,50 @@ void writefile(char *myfile) {
 
 void removefile(char *name) {
     extern LaosFileSystem sd;
-    char shortname[SHORTFILESIZE] = "";
-    sd.getshortname(shortname, name);
-    if (strlen(shortname) != 0) {
+    if (strlen(name) != 0) {
         char fullname[MAXFILESIZE+SHORTFILESIZE+1];
-        sprintf(fullname, "%s%s", sd.pathname, shortname);
+        sprintf(fullname, "%s%s", sd.pathname, name);
         if (remove(fullname) < 0)
             printf("Error while removing file %s\n\r", fullname);
-        sd.cleanlist();           
+        else {
+            sd.deljob(name);
+            deljobindex(name);
+        }
     } 
 }
 
+// Read an integer from a character source, returns 0 at the end
+static int parseint(int (*next)(void *), void *src)
+{
+  LaosParser parser;
+  int c, val;
+  while( (c = next(src)) != EOF )
+    if ( parser.put(c, &val) )
+      return val;
+  return 0;
+} // parse integer
+
+static int filenext(void *src)
+{
+  return fgetc((FILE*)src);
+}
+
+static int readaheadnext(void *src)
+{
+  return ((LaosReadAhead*)src)->next();
+}
+
 // Read an integer from file
 int readint(FILE *fp)
 {
-  unsigned short int i=0;
-  int sign=1;
-  char c, str[16];
-  
-  while( !feof(fp)  )
-  {
-    fread(&c, sizeof(c),1,fp);   
-    
-    switch(c)
-    {
-      case '0': case '1': case '2':  case '3':  case '4': 
-      case '5': case '6': case '7':  case '8':  case '9':  
-        if ( i < sizeof(str)) 
-          str[i++] = (char)c;
-        break;
-      case '-': sign = -1; break;
-      case ';': while ((!feof(fp)) && (c != '\n')) {
-            fread(&c, sizeof(c),1,fp);
-        }
-        break; 
-      case ' ': case '\t': case '\r': case '\n':
-        if ( i )
-        {
-          int val=0, d=1;
-          while(i) 
-          {
-            if ( str[i-1] == '-' ) 
-              d *= -1;
-            else
-              val += (str[i-1]-'0') * d;
-            d *= 10;
-            i--;
-          }
-          val *= sign;
-          return val;
-        }
-        break;
-    } // Switch
-  } // while
-  return 0;
-} // read integer
+  return parseint(filenext, fp);
+}
+
+// Read an integer from a buffered job file
+int readint(LaosReadAhead *in)
+{
+  return parseint(readaheadnext, in);
+}
 
 void strtolower(char *name) {
     for(unsigned int i = 0; i < strlen(name); i++)
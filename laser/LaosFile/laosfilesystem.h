@@ -1,7 +1,7 @@
 /*
  *
  * LaosFilesystem.h
- * Simple Long Filename system on top of SDFilesystem.h
+ * Long filename helpers on top of SDFilesystem.h
  *
  * Copyright (c) 2011 Jaap Vermaas
  *
@@ -27,30 +27,85 @@
 #include "FATFileSystem.h"
 #include <string>
 #include <ctype.h>
+#include "laosreadahead.h"
 
-#define _LAOSFILE_TRANSTABLE "longname.sys"
+#define _LAOSFILE_TRANSTABLE "longname.sys"  // only read to convert old cards
+#define _LAOSFILE_JOBINDEX "jobindex.sys"  // extents of analyzed jobs (laosjobindex.h)
+#define _LAOSFILE_OPTIMIZE "optimize.sys"  // job that is being reordered (laosoptimize.h)
+#define _LAOSFILE_REPLACED "replaced.sys"  // job that is being replaced by its reordered copy
 #define MAXFILESIZE 21
 #define SHORTFILESIZE 13
 
+// Entry in the list of files on the card
+typedef struct {
+    char name[MAXFILESIZE];
+    unsigned long size;
+    unsigned short date, time;  // FAT timestamp of the last write
+    short indexrec;             // record in the job index (laosjobindex.h), -1: not known
+} LaosJob;
+
+// Simplecode parser: takes one character at a time, so it can parse data
+// as it arrives (readint() uses it on files)
+class LaosParser {
+    public:
+        LaosParser() { reset(); }
+        void reset() { val = 0; sign = 1; digits = 0; comment = false; }
+        // feed a character, returns 1 when *value holds the next integer
+        inline int put(int c, int *value) {
+            if (comment) {
+                if (c == '\n') comment = false;
+                return 0;
+            }
+            switch (c) {
+                case '0': case '1': case '2': case '3': case '4':
+                case '5': case '6': case '7': case '8': case '9':
+                    if (digits < 16) {  // ignore digits beyond 16
+                        val = val * 10 + (c - '0');
+                        digits++;
+                    }
+                    return 0;
+                case '-': sign = -1; return 0;
+                case ';': comment = true; return 0;   // skip to end of line
+                case ' ': case '\t': case '\r': case '\n':
+                    if (digits) {
+                        *value = val * sign;
+                        reset();
+                        return 1;
+                    }
+                    return 0;
+            }
+            return 0;
+        }
+    private:
+        int val, sign;
+        short digits;
+        bool comment;
+};
+
 class LaosFileSystem : public SDFileSystem {
     public:
         LaosFileSystem(PinName mosi, PinName miso, PinName sclk, PinName cs, 
                 const char* name);        // Create the filesystem on SD
         virtual ~LaosFileSystem();                // destructor
         FILE* openfile(char* name, const std::string& iom);    // open a file
-        void getlongname(char *result, char *searchname);   // return long names
-        void getshortname(char* shortname, char* name); //get a short name
+        void migrate();         // rename files listed in longname.sys
+        void scanjobs();        // (re)build the job list from the directory
+        void addjob(char* name);    // add or update a job after writing it
+        void deljob(char* name);    // forget a removed job
+        int jobcount();             // number of jobs in the list
+        int findjob(char* name);    // index of a job, or -1
+        LaosJob* getjob(int n);     // n-th job in alphabetical order
         char pathname[MAXFILESIZE+2];
-        void cleanlist();
         void shorten(char* name, int max);
         
     private:
         int islegalname(char* name);
-        int isshortname(char* name);
-        void removespaces(char* name);
-        void makeshortname(char* shortname, char* name);
         size_t dirread(char* longname, char* shortname, FILE *fp);
-        size_t dirwrite(char* longname, char* shortname, FILE* fp);
+        int searchjob(const char* name, int* pos);
+        void insertjob(const char* name, FILINFO* finfo);
+        LaosJob *jobs;          // job list, sorted by name
+        short njobs, jobsize;
+        bool jobsloaded;
         char tablename[MAXFILESIZE + SHORTFILESIZE + 1];
 };
 
@@ -64,6 +119,7 @@ void getnextjob(char *name);     // next job
 void writefile(char *name); // example code to open a file
 void removefile(char *name);    // example code to remove a file
 int readint(FILE *fp);      // read integers from open file
+int readint(LaosReadAhead *in); // read integers from a buffered job file
 void strtolower(char *name);    // change characters to lowercase
 int isFirmware(char *name);     // check if it's firmware
 void installFirmware(char *filename); // put firmware in place
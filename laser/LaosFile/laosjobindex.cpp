@@ -0,0 +1,234 @@
+/*
+ * laosjobindex.cpp
+ * Index of analyzed jobs, so a job is read only once to get its extent
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "laosjobindex.h"
+
+extern LaosFileSystem sd;
+
+// full path of the index file
+static char* indexname(char *name) {
+    sprintf(name, "%s%s", sd.pathname, _LAOSFILE_JOBINDEX);
+    return name;
+}
+
+// header of an index written by this firmware
+static void indexheader(LaosJobIndexHeader *hdr) {
+    memset(hdr, 0, sizeof(LaosJobIndexHeader));
+    hdr->magic = JOBINDEX_MAGIC;
+    hdr->version = JOBINDEX_VERSION;
+    hdr->recsize = sizeof(LaosJobIndex);
+}
+
+// open the index file, NULL if there is none or it has another header
+static FILE* openindex(const char *mode) {
+    char name[MAXFILESIZE+SHORTFILESIZE+1];
+    LaosJobIndexHeader hdr, ours;
+    FILE *fp = fopen(indexname(name), mode);
+    if (fp == NULL)
+        return NULL;
+    indexheader(&ours);
+    if ((fread(&hdr, sizeof(hdr), 1, fp) == 1) && (memcmp(&hdr, &ours, sizeof(hdr)) == 0))
+        return fp;
+    fclose(fp);
+    return NULL;
+}
+
+// start a new, empty index file
+static FILE* newindex() {
+    char name[MAXFILESIZE+SHORTFILESIZE+1];
+    LaosJobIndexHeader hdr;
+    FILE *fp = fopen(indexname(name), "w+b");
+    if (fp == NULL)
+        return NULL;
+    indexheader(&hdr);
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// file offset of record n
+static long indexoffset(int n) {
+    return sizeof(LaosJobIndexHeader) + n * sizeof(LaosJobIndex);
+}
+
+// size and timestamp of a job file
+static int statjob(char *name, FILINFO *finfo) {
+    finfo->lfname = NULL;
+    return (f_stat(name, finfo) == FR_OK);
+}
+
+// find the record of name, returns the record nr (or -1), and the first
+// free record in *freerec (or the nr of records if there is none)
+static int findindex(FILE *fp, char *name, LaosJobIndex *rec, int *freerec) {
+    int n = 0;
+    if (freerec != NULL)
+        *freerec = -1;
+    fseek(fp, indexoffset(0), SEEK_SET);
+    while (fread(rec, sizeof(LaosJobIndex), 1, fp) == 1) {
+        if (strcasecmp(rec->name, name) == 0)
+            return n;
+        if ((freerec != NULL) && (*freerec < 0) && (rec->name[0] == 0))
+            *freerec = n;
+        n++;
+    }
+    if ((freerec != NULL) && (*freerec < 0))
+        *freerec = n;
+    return -1;
+}
+
+// find the record of a job in the job list: the record nr it remembers is
+// tried first, the index is only searched when that record has another name
+static int lookupindex(FILE *fp, LaosJob *job, LaosJobIndex *rec) {
+    if (job->indexrec >= 0) {
+        fseek(fp, indexoffset(job->indexrec), SEEK_SET);
+        if ((fread(rec, sizeof(LaosJobIndex), 1, fp) == 1) && (strcasecmp(rec->name, job->name) == 0))
+            return job->indexrec;
+    }
+    job->indexrec = findindex(fp, job->name, rec, NULL);
+    return job->indexrec;
+}
+
+// Get the extent of a job, returns 1 if the job was analyzed and did not
+// change since
+int getjobindex(char *name, TExtentSummary *extent) {
+    FILINFO finfo;
+    LaosJobIndex rec;
+    LaosJob *job = sd.getjob(sd.findjob(name));
+    if (job != NULL) {  // the job list has the size and timestamp
+        finfo.fsize = job->size;
+        finfo.fdate = job->date;
+        finfo.ftime = job->time;
+    } else if (!statjob(name, &finfo)) {
+        return 0;
+    }
+    FILE *fp = openindex("rb");
+    if (fp == NULL)
+        return 0;
+    int n = (job != NULL ? lookupindex(fp, job, &rec) : findindex(fp, name, &rec, NULL));
+    int found = (n >= 0) && 
+        (rec.size == finfo.fsize) && (rec.date == finfo.fdate) && (rec.time == finfo.ftime);
+    fclose(fp);
+    if (found)
+        *extent = rec.extent;
+    return found;
+}
+
+// Store the extent of a job
+void putjobindex(char *name, const TExtentSummary *extent) {
+    FILINFO finfo;
+    LaosJobIndex rec;
+    int n, freerec;
+    if ((strlen(name) >= MAXFILESIZE) || !statjob(name, &finfo))
+        return;
+    FILE *fp = openindex("r+b");
+    if (fp == NULL)
+        fp = newindex();  // first record, or an outdated index
+    if (fp == NULL) {
+        printf("Could not write %s\n\r", _LAOSFILE_JOBINDEX);
+        return;
+    }
+    if ((n = findindex(fp, name, &rec, &freerec)) < 0)
+        n = freerec;
+    memset(&rec, 0, sizeof(rec));
+    strcpy(rec.name, name);
+    rec.size = finfo.fsize;
+    rec.date = finfo.fdate;
+    rec.time = finfo.ftime;
+    rec.extent = *extent;
+    fseek(fp, indexoffset(n), SEEK_SET);
+    fwrite(&rec, sizeof(LaosJobIndex), 1, fp);
+    fclose(fp);
+    LaosJob *job = sd.getjob(sd.findjob(name));
+    if (job != NULL)
+        job->indexrec = n;
+}
+
+// Clear the record of a removed job
+void deljobindex(char *name) {
+    LaosJobIndex rec;
+    FILE *fp = openindex("r+b");
+    if (fp == NULL)
+        return;
+    int n = findindex(fp, name, &rec, NULL);
+    if (n >= 0) {
+        memset(&rec, 0, sizeof(rec));
+        fseek(fp, indexoffset(n), SEEK_SET);
+        fwrite(&rec, sizeof(LaosJobIndex), 1, fp);
+    }
+    fclose(fp);
+}
+
+// print the statistics of an analyzed job
+static void printsummary(char *name, TExtentSummary *summary) {
+    printf("%s: %lu segments, %d mm path, %d mm laser on, %d sec, %lu stops, %d sec saved\n\r", name, 
+        summary->Segments, (int)summary->PathLength, (int)summary->LaserLength, 
+        (int)summary->Time, summary->Stops, (int)summary->SavedTime);
+}
+
+// Analyze a job file and store the result
+void indexjob(char *name) {
+    FILE *fp = sd.openfile(name, "rb");
+    if (fp == NULL)
+        return;
+    LaosReadAhead in;
+    LaosExtent extent;
+    TExtentSummary summary;
+    extent.Reset(false);
+    in.open(fp);
+    while (!in.eof())
+        extent.Write(readint(&in));
+    in.close();
+    fclose(fp);
+    extent.GetSummary(summary);
+    printsummary(name, &summary);
+    putjobindex(name, &summary);
+}
+
+// a new upload (firmware is not analyzed)
+void LaosJobAnalyzer::start(char *name) {
+    active = !isFirmware(name);
+    parser.reset();
+    extent.Reset(false);
+}
+
+// data as written to the file
+void LaosJobAnalyzer::write(const char *data, int len) {
+    int val;
+    if (!active)
+        return;
+    for (int i=0; i < len; i++)
+        if (parser.put(data[i], &val))
+            extent.Write(val);
+}
+
+// upload complete: store the result (the file must be closed)
+void LaosJobAnalyzer::finish(char *name) {
+    TExtentSummary summary;
+    if (!active)
+        return;
+    active = false;
+    extent.GetSummary(summary);
+    printsummary(name, &summary);
+    putjobindex(name, &summary);
+}
@@ -0,0 +1,78 @@
+/*
+ * laosjobindex.h
+ * Index of analyzed jobs, so a job is read only once to get its extent
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The index is a file of fixed size records on the card, one per job: the
+ * name, size and FAT timestamp of the job file, and the LaosExtent summary
+ * (boundaries, nr of segments, path length). A record is only used when the
+ * size and timestamp still match the file, so a job that was overwritten is
+ * analyzed again. Records of removed jobs are cleared and reused.
+ * The job list (LaosJob) remembers the record nr of a job and its size and
+ * timestamp, so looking up a listed job reads one record.
+ * The file starts with a header (magic, version, record size). An index
+ * with another header is from other firmware: it is not used, and is
+ * rebuilt from scratch when the next record is stored.
+ *
+ * The upload servers feed the received data to a LaosJobAnalyzer, so the
+ * record is ready when the transfer completes without reading the file back.
+ */
+#ifndef _LAOSJOBINDEX_H_
+#define _LAOSJOBINDEX_H_
+
+#include "laosfilesystem.h"
+#include "LaosExtent.h"
+
+#define JOBINDEX_MAGIC 0x584A4C4CUL   // "LLJX"
+#define JOBINDEX_VERSION 1          // increase when LaosJobIndex or TExtentSummary change
+
+// Header of the job index file
+typedef struct {
+    unsigned long magic;        // JOBINDEX_MAGIC
+    unsigned short version;     // JOBINDEX_VERSION
+    unsigned short recsize;     // sizeof(LaosJobIndex)
+} LaosJobIndexHeader;
+
+// Record in the job index
+typedef struct {
+    char name[MAXFILESIZE];     // empty: free record
+    unsigned long size;
+    unsigned short date, time;  // FAT timestamp of the last write
+    TExtentSummary extent;
+} LaosJobIndex;
+
+int getjobindex(char *name, TExtentSummary *extent);  // 1: extent of an unchanged job found
+void putjobindex(char *name, const TExtentSummary *extent);   // store the extent of a job
+void deljobindex(char *name);   // clear the record of a removed job
+void indexjob(char *name);      // analyze a job file and store the result
+
+// Analyze a job while it is received
+class LaosJobAnalyzer {
+    public:
+        LaosJobAnalyzer() { active = false; }
+        void start(char *name);     // a new upload (firmware is not analyzed)
+        void write(const char *data, int len);  // data as written to the file
+        void finish(char *name);    // upload complete: store the result
+    private:
+        LaosParser parser;
+        LaosExtent extent;
+        bool active;
+};
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * laosoptimize.cpp
+ * Reorder the paths of a job to shorten the moves with the laser off
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "laosoptimize.h"
+#include "global.h"
+#include <math.h>
+
+extern LaosFileSystem sd;
+
+// A move followed by lines with the laser on
+typedef struct {
+    long offset;        // file position of the move
+    long count;         // nr of commands: the move and the lines
+    int sx, sy;         // start [um]
+    int ex, ey;         // end [um]
+} LaosPath;
+
+class LaosOptimizer {
+    public:
+        LaosOptimizer(FILE *in, FILE *src, FILE *out);
+        ~LaosOptimizer();
+        void run();
+        float before, after;    // length of the moves between the paths [um]
+    private:
+        void addpath();
+        void endgroup();
+        void flush(bool fixedend, int endx, int endy);
+        void copypath(LaosPath *p);
+        void copycommand(int c);
+        FILE *in, *src, *out;   // job (read in order and at the paths), new job
+        LaosPath *paths;        // paths that can be reordered
+        int npaths;
+        LaosPath cur;           // path that is being read (count 0: none)
+        int x, y;               // position after the commands written so far
+        bool pinned;            // a command applies to the next line: its path is not reordered
+};
+
+// length of a move [um]
+static inline float distance(int x1, int y1, int x2, int y2) {
+    float dx = x2 - x1, dy = y2 - y1;
+    return sqrtf(dx*dx + dy*dy);
+}
+
+LaosOptimizer::LaosOptimizer(FILE *in, FILE *src, FILE *out) {
+    this->in = in;
+    this->src = src;
+    this->out = out;
+    paths = new LaosPath[OPTIMIZE_PATHS];
+    npaths = 0;
+    cur.count = 0;
+    x = y = 0;
+    pinned = false;
+    before = after = 0;
+}
+
+LaosOptimizer::~LaosOptimizer() {
+    delete[] paths;
+}
+
+// copy the job, reordering the paths between other commands
+void LaosOptimizer::run() {
+    for (;;) {
+        long offset = ftell(in);
+        int c = readint(in);
+        if (feof(in))
+            break;
+        switch (c) {
+            case 0: // move: a new path
+                addpath();
+                cur.offset = offset;
+                cur.count = 1;
+                cur.sx = cur.ex = readint(in);
+                cur.sy = cur.ey = readint(in);
+                break;
+            case 1: // line
+                if (cur.count) {
+                    cur.count++;
+                    cur.ex = readint(in);
+                    cur.ey = readint(in);
+                } else {    // continues from the previous command
+                    x = readint(in);
+                    y = readint(in);
+                    fprintf(out, "1 %d %d\n", x, y);
+                    pinned = false;
+                }
+                break;
+            default:
+                endgroup();
+                copycommand(c);
+                break;
+        }
+    }
+    endgroup();
+}
+
+// the path that was read can be reordered (moves without lines are left out),
+// unless its first line takes a bitmap: then it goes first
+void LaosOptimizer::addpath() {
+    if ((cur.count > 1) && pinned) {
+        copypath(&cur);     // nothing to reorder before it
+        pinned = false;
+    } else if (cur.count > 1) {
+        if (npaths == OPTIMIZE_PATHS)
+            flush(false, 0, 0);
+        paths[npaths++] = cur;
+    }
+    cur.count = 0;
+}
+
+// a command other than a move or line: the last path stays last
+void LaosOptimizer::endgroup() {
+    if (cur.count) {
+        flush(true, cur.sx, cur.sy);
+        copypath(&cur);
+        if (cur.count > 1)
+            pinned = false;
+        cur.count = 0;
+    } else {
+        flush(false, 0, 0);
+    }
+}
+
+// write the paths in the order with the shortest moves, from the current
+// position to the end position (if fixedend)
+void LaosOptimizer::flush(bool fixedend, int endx, int endy) {
+    unsigned char order[OPTIMIZE_PATHS];
+    int n = npaths;
+    if (n == 0)
+        return;
+    // original order
+    int px = x, py = y;
+    for (int i=0; i < n; i++) {
+        before += distance(px, py, paths[i].sx, paths[i].sy);
+        px = paths[i].ex;
+        py = paths[i].ey;
+        order[i] = i;
+    }
+    // nearest neighbour
+    px = x;
+    py = y;
+    for (int i=0; i < n; i++) {
+        int best = i;
+        float bestdist = distance(px, py, paths[order[i]].sx, paths[order[i]].sy);
+        for (int j=i+1; j < n; j++) {
+            float d = distance(px, py, paths[order[j]].sx, paths[order[j]].sy);
+            if (d < bestdist) {
+                best = j;
+                bestdist = d;
+            }
+        }
+        unsigned char t = order[i];
+        order[i] = order[best];
+        order[best] = t;
+        px = paths[order[i]].ex;
+        py = paths[order[i]].ey;
+    }
+    // 2-opt: reverse the order of the paths i..j if that shortens the moves.
+    // The moves between the reversed paths change as well (a move goes from
+    // the end of one path to the start of the next), their length before and
+    // after is summed while j increases.
+    bool improved = true;
+    for (int pass=0; improved && (pass < OPTIMIZE_PASSES); pass++) {
+        improved = false;
+        for (int i=0; i < n-1; i++) {
+            LaosPath *a = &paths[order[i]];
+            int prevx = (i == 0 ? x : paths[order[i-1]].ex);
+            int prevy = (i == 0 ? y : paths[order[i-1]].ey);
+            float fwd = 0, rev = 0;
+            for (int j=i+1; j < n; j++) {
+                LaosPath *b = &paths[order[j]];
+                LaosPath *p = &paths[order[j-1]];
+                fwd += distance(p->ex, p->ey, b->sx, b->sy);
+                rev += distance(b->ex, b->ey, p->sx, p->sy);
+                float oldlen = distance(prevx, prevy, a->sx, a->sy) + fwd;
+                float newlen = distance(prevx, prevy, b->sx, b->sy) + rev;
+                if (j < n-1) {
+                    LaosPath *next = &paths[order[j+1]];
+                    oldlen += distance(b->ex, b->ey, next->sx, next->sy);
+                    newlen += distance(a->ex, a->ey, next->sx, next->sy);
+                } else if (fixedend) {
+                    oldlen += distance(b->ex, b->ey, endx, endy);
+                    newlen += distance(a->ex, a->ey, endx, endy);
+                }
+                if (newlen < oldlen - 1) {
+                    for (int k=i, l=j; k < l; k++, l--) {
+                        unsigned char t = order[k];
+                        order[k] = order[l];
+                        order[l] = t;
+                    }
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    for (int i=0; i < n; i++) {
+        after += distance(x, y, paths[order[i]].sx, paths[order[i]].sy);
+        copypath(&paths[order[i]]);
+    }
+    if (fixedend) {
+        before += distance(paths[n-1].ex, paths[n-1].ey, endx, endy);
+        after += distance(x, y, endx, endy);
+    }
+    npaths = 0;
+}
+
+// copy a path from the job
+void LaosOptimizer::copypath(LaosPath *p) {
+    fseek(src, p->offset, SEEK_SET);
+    for (long i=0; i < p->count; i++) {
+        int c = readint(src);
+        x = readint(src);
+        y = readint(src);
+        fprintf(out, "%d %d %d\n", c, x, y);
+    }
+}
+
+// copy a command with its values, see LaosMotion::write()
+void LaosOptimizer::copycommand(int c) {
+    int n;
+    fprintf(out, "%d", c);
+    switch (c) {
+        case 4: // set position x,y,z
+            x = readint(in);
+            y = readint(in);
+            fprintf(out, " %d %d", x, y);
+            n = 1;
+            break;
+        case 7: { // set index,value
+            int index = readint(in);
+            fprintf(out, " %d", index);
+            if (index == 103) // end power of the next line
+                pinned = true;
+            n = 1;
+            break;
+        }
+        case 9: { // bitmap: bpp, width, data
+            int bpp = readint(in);
+            int width = readint(in);
+            fprintf(out, " %d %d", bpp, width);
+            n = (bpp * width + 31) / 32;
+            pinned = true;
+            break;
+        }
+        case 11: { // streamed bitmap line: x, y, bpp, width, data
+            x = readint(in);
+            y = readint(in);
+            int bpp = readint(in);
+            int width = readint(in);
+            fprintf(out, " %d %d %d %d", x, y, bpp, width);
+            n = (bpp * width + 31) / 32;
+            break;
+        }
+        case 10: { // run length coded bitmap: width, nr of runs, runs
+            int width = readint(in);
+            n = readint(in);
+            fprintf(out, " %d %d", width, n);
+            pinned = true;
+            break;
+        }
+        default: // move z, nop and unknown commands take one value
+            n = 1;
+            break;
+    }
+    while (n-- > 0)
+        fprintf(out, " %d", readint(in));
+    fprintf(out, "\n");
+}
+
+// Reorder the paths of a job (if sys.optimize is set). The job is replaced
+// when the moves get shorter, the caller has to update the job list.
+int optimizejob(char *name) {
+    extern GlobalConfig *cfg;
+    char tmpname[MAXFILESIZE+SHORTFILESIZE+1];
+    char fullname[MAXFILESIZE+SHORTFILESIZE+1];
+    char oldname[MAXFILESIZE+SHORTFILESIZE+1];
+    if (!cfg->optimize || isFirmware(name))
+        return 0;
+    FILE *in = sd.openfile(name, "rb");
+    FILE *src = sd.openfile(name, "rb");
+    sprintf(tmpname, "%s%s", sd.pathname, _LAOSFILE_OPTIMIZE);
+    FILE *out = fopen(tmpname, "wb");
+    if ((in == NULL) || (src == NULL) || (out == NULL)) {
+        printf("optimize: could not open %s\n\r", name);
+        if (in != NULL) fclose(in);
+        if (src != NULL) fclose(src);
+        if (out != NULL) fclose(out);
+        return 0;
+    }
+    LaosOptimizer optimizer(in, src, out);
+    optimizer.run();
+    int ok = !ferror(out);
+    fclose(in);
+    fclose(src);
+    if (fclose(out) != 0) // the last data is written on close
+        ok = 0;
+    printf("optimize %s: moves %d mm -> %d mm\n\r", name, 
+        (int)(optimizer.before/1000), (int)(optimizer.after/1000));
+    if (!ok || (optimizer.after >= optimizer.before)) {
+        remove(tmpname);
+        return 0;
+    }
+    // rename does not overwrite: move the job aside, and only remove it
+    // when the new file has its name
+    sprintf(fullname, "%s%s", sd.pathname, name);
+    sprintf(oldname, "%s%s", sd.pathname, _LAOSFILE_REPLACED);
+    remove(oldname);    // left behind by a reset during a replace
+    if (rename(fullname, oldname) != 0) {
+        printf("optimize: could not replace %s\n\r", name);
+        remove(tmpname);
+        return 0;
+    }
+    if (rename(tmpname, fullname) != 0) {
+        printf("optimize: could not replace %s\n\r", name);
+        rename(oldname, fullname);
+        remove(tmpname);
+        return 0;
+    }
+    remove(oldname);
+    return 1;
+}
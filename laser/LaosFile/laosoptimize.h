@@ -0,0 +1,46 @@
+/*
+ * laosoptimize.h
+ * Reorder the paths of a job to shorten the moves with the laser off
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A path is a move (command 0) followed by lines with the laser on
+ * (command 1). Between two other commands (power, speed, bitmap, set
+ * position...) the order of the paths does not matter, except for the
+ * last one: the commands after it start where it ends. A bitmap or an
+ * end power (7 103) applies to the next line, so the first path after it
+ * keeps its place as well.
+ * The other paths are put in a new order: nearest neighbour first, then
+ * improved with 2-opt.
+ * Paths are not reversed, so every line is cut in its original direction.
+ *
+ * Only the file position, size and end points of a path are kept, up to
+ * OPTIMIZE_PATHS at a time; the paths are copied from the job to a new
+ * file in their new order, which then replaces the job.
+ */
+#ifndef _LAOSOPTIMIZE_H_
+#define _LAOSOPTIMIZE_H_
+
+#include "laosfilesystem.h"
+
+#define OPTIMIZE_PATHS 64   // nr of paths that are reordered at a time
+#define OPTIMIZE_PASSES 8   // max nr of 2-opt passes over those paths
+
+int optimizejob(char *name);    // reorder the paths of a job, 1 if the job was rewritten
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * laosreadahead.cpp
+ * Read-ahead buffering for job files
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "laosreadahead.h"
+
+LaosReadAhead::LaosReadAhead() {
+    data = new char[READAHEAD_BUFFERS * READAHEAD_SIZE];
+    for (int i=0; i < READAHEAD_BUFFERS; i++)
+        buf[i] = data + i * READAHEAD_SIZE;
+    fp = NULL;
+    close();
+}
+
+LaosReadAhead::~LaosReadAhead() {
+    delete[] data;
+}
+
+// read fp from its current position, fill all buffers
+void LaosReadAhead::open(FILE *f) {
+    fp = f;
+    head = count = pos = 0;
+    done = ateof = false;
+    hits = misses = 0;
+    setvbuf(fp, NULL, _IONBF, 0); // whole sectors go straight into the buffers
+    base = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    filesize = ftell(fp);
+    fseek(fp, base, SEEK_SET);
+    while (fill() > 0);
+}
+
+// forget the file, the caller closes it
+void LaosReadAhead::close() {
+    fp = NULL;
+    head = count = pos = 0;
+    base = filesize = 0;
+    done = ateof = true;
+}
+
+// read the free buffers up to the end of the ring with one fread, so FatFs
+// gets them as one multiple sector read. An empty ring starts at the first
+// buffer; free buffers at the start of a ring that wraps are read by the
+// next call. Returns nr of bytes read.
+int LaosReadAhead::fill() {
+    if (done || (count == READAHEAD_BUFFERS))
+        return 0;
+    if (count == 0)
+        head = pos = 0;
+    int n = (head + count) % READAHEAD_BUFFERS;
+    int nfree = (n < head ? head : READAHEAD_BUFFERS) - n;
+    int rd = fread(buf[n], 1, nfree * READAHEAD_SIZE, fp);
+    if (rd <= 0) {
+        done = true;
+        return 0;
+    }
+    for (int left = rd; left > 0; left -= READAHEAD_SIZE) {
+        len[n++] = (left < READAHEAD_SIZE ? left : READAHEAD_SIZE);
+        count++;
+    }
+    return rd;
+}
+
+// next character, or EOF
+int LaosReadAhead::next() {
+    if ((count > 0) && (pos == len[head])) { // head buffer used up
+        base += len[head];
+        head = (head + 1) % READAHEAD_BUFFERS;
+        count--;
+        pos = 0;
+        if (count > 0)
+            hits++;
+    }
+    if (count == 0) {
+        if (fill() == 0) {
+            ateof = true;
+            return EOF;
+        }
+        misses++;
+    }
+    return (unsigned char)buf[head][pos++];
+}
+
+// true after next() returned EOF (like feof())
+int LaosReadAhead::eof() {
+    return ateof;
+}
+
+// drop the rest of the file (job cancelled)
+void LaosReadAhead::skip() {
+    if (fp != NULL)
+        fseek(fp, 0, SEEK_END);
+    base = filesize;
+    head = count = pos = 0;
+    done = ateof = true;
+}
+
+// fill the free buffers, call this when there is time to wait for the card
+void LaosReadAhead::prefetch() {
+    while (fill() > 0);
+}
+
+// bytes taken by the parser
+long LaosReadAhead::tell() {
+    return base + pos;
+}
+
+// size of the file [bytes]
+long LaosReadAhead::size() {
+    return filesize;
+}
@@ -0,0 +1,78 @@
+/*
+ * laosreadahead.h
+ * Read-ahead buffering for job files
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Keeps the next READAHEAD_BUFFERS sectors of an open job file in memory.
+ * The parser takes characters from the buffers; prefetch() refills the
+ * free buffers and is called while the planner queue is full, so the card
+ * is read while the machine is busy instead of when the parser needs data.
+ * The buffers are one block of memory, so free buffers next to each other
+ * are read with one fread (a multiple sector read on the card).
+ * open() makes the file unbuffered, so it must be the first operation on
+ * the file after fopen.
+ * A buffer that was already filled when the parser reached it counts as a
+ * hit, a buffer that had to be read on the spot counts as a miss.
+ *
+ * Example:
+ * @code
+ * LaosReadAhead in;
+ * FILE *fp = sd.openfile(name, "rb");
+ * in.open(fp);
+ * while (!in.eof()) {
+ *   if (!mot->ready()) in.prefetch();
+ *   else mot->write(readint(&in));
+ * }
+ * in.close();
+ * @endcode
+ */
+#ifndef _LAOSREADAHEAD_H_
+#define _LAOSREADAHEAD_H_
+
+#include <stdio.h>
+
+#define READAHEAD_BUFFERS 4     // nr of buffers
+#define READAHEAD_SIZE 512      // size of one buffer (one sector) [bytes]
+
+class LaosReadAhead {
+    public:
+        LaosReadAhead();
+        ~LaosReadAhead();
+        void open(FILE *fp);    // read fp from its current position
+        void close();           // forget the file (does not close it)
+        int next();             // next character, or EOF
+        int eof();              // true after next() returned EOF
+        void skip();            // drop the rest of the file
+        void prefetch();        // fill the free buffers
+        long tell();            // bytes taken by the parser
+        long size();            // size of the file [bytes]
+        unsigned long hits, misses;   // buffers ready in time / read on demand
+
+    private:
+        int fill();
+        FILE *fp;
+        char *data;             // all buffers
+        char *buf[READAHEAD_BUFFERS];
+        short len[READAHEAD_BUFFERS];
+        short head, count, pos;     // first filled buffer, nr filled, read position
+        long base, filesize;        // file offset of the head buffer, file size
+        bool done, ateof;           // file read to the end, parser at the end
+};
+
+#endif
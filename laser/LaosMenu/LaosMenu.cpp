@@ -21,6 +21,8 @@
  *
  */
 #include "LaosMenu.h"
+#include "StatusServer.h"
+#include "laosjobindex.h"
 #include "stepper.h"
 #include "pins.h"
 
@@ -138,6 +140,10 @@ static const char *screens[] = {
     "ERROR:          "
     "$$$$$$$$$$$$$$$$",
 
+#define ESTIMATE (ERROR+1)
+    "Time: 3210m 10s "
+    "v:3210 stops:210",
+
 };
 
 
@@ -221,6 +227,7 @@ void LaosMenu::Handle() {
     extern LaosFileSystem sd;
     extern LaosMotion *mot;
     extern GlobalConfig *cfg;
+    extern StatusServer *statsrv;
     static int count=0;
     
     int c = dsp->read();
@@ -519,32 +526,41 @@ void LaosMenu::Handle() {
                             runfile = sd.openfile(jobname, "rb");
                             if (! runfile) 
                               screen=MAIN;
-                            else
+                            else {
                                mot->reset();
+                               m_Reader.open(runfile);
+                               statsrv->jobStart(jobname, &m_Reader);
+                            }
                         } else {
                                 #ifdef READ_FILE_DEBUG
                                     printf("Parsing file: \n");
                                 #endif
-                            while ((!feof(runfile)) && mot->ready()) {
-                                mot->write(readint(runfile));
+                            while ((!m_Reader.eof()) && mot->ready()) {
+                                mot->write(readint(&m_Reader));
                                 if(cfg->disablecancelcheck == false)
                                 {
                                     if(dsp->read_nb() == K_CANCEL) {
+                                       mot->stopStream();
                                        while (mot->queue());
                                        mot->reset();
-                                       fseek(runfile, 0, SEEK_END);
+                                       m_Reader.skip();
                                     }
                                 }
                             }
                             #ifdef READ_FILE_DEBUG
                                     printf("File parsed \n");
                                 #endif
-                            if (feof(runfile) && mot->ready()) {
+                            if (m_Reader.eof() && mot->ready()) {
+                                mot->finish(); // in case the file ends in a streamed row or a move
+                                statsrv->jobEnd();
+                                printf("Read ahead: %lu hits, %lu misses\n", m_Reader.hits, m_Reader.misses);
+                                m_Reader.close();
                                 fclose(runfile);
                                 runfile = NULL;
                                 mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
                                 screen=MAIN;
                             } else {
+                                m_Reader.prefetch(); // the planner is full: read the card now
                                 nodisplay = 1;
                             }
                         }
@@ -578,9 +594,22 @@ void LaosMenu::Handle() {
                     // when executing BOUNDARIES we only need the actual lasered area
                     bool boundsOnlyWithLaserOn = (m_StageAfterAnalyzing == CALCULATEDBOUNDARIES);
                     m_Extent.Reset(boundsOnlyWithLaserOn);
-                    while (!feof(runfile))
+                    TExtentSummary summary;
+                    if (getjobindex(jobname, &summary))
                     {
-                        m_Extent.Write(readint(runfile));
+                        // analyzed before (on upload or an earlier run)
+                        m_Extent.SetSummary(summary);
+                    }
+                    else
+                    {
+                        m_Reader.open(runfile);
+                        while (!m_Reader.eof())
+                        {
+                            m_Extent.Write(readint(&m_Reader));
+                        }
+                        m_Reader.close();
+                        m_Extent.GetSummary(summary);
+                        putjobindex(jobname, &summary);
                     }
                     fclose(runfile);
                     runfile = NULL;
@@ -640,11 +669,48 @@ void LaosMenu::Handle() {
                         case K_CANCEL:
                          screen=MAIN;
                          break;
+                        case K_LEFT: case K_RIGHT: // trace the outline of the job
+                         m_Extent.ShowOutline(mot);
+                         waitup=1;
+                         break;
+                        case K_UP: case K_DOWN: // show the time estimate
+                        {
+                         TExtentSummary summary;
+                         m_Extent.GetSummary(summary);
+                         args[0]=(int)summary.Time / 60;
+                         args[1]=(int)summary.Time % 60;
+                         args[2]=(summary.Time > 0 ? (int)(summary.PathLength / summary.Time) : 0);
+                         args[3]=summary.Stops;
+                         screen=ESTIMATE;
+                         waitup=1;
+                         break;
+                        }
                     }
                     break;
                 }
                 break;
 
+            case ESTIMATE: // estimated run time, average speed and full stops of the job
+                switch ( c ) {
+                    case K_OK:
+                    case K_CANCEL:
+                        screen=MAIN;
+                        break;
+                    case K_UP: case K_DOWN: // back to the boundaries
+                    {
+                        int fileMinx, fileMiny, fileMaxx, fileMaxy;
+                        m_Extent.GetBoundary(fileMinx, fileMiny, fileMaxx, fileMaxy);
+                        args[0]=(fileMinx+500)/1000;
+                        args[1]=(fileMiny+500)/1000;
+                        args[2]=((fileMaxx-fileMinx)+500)/1000;
+                        args[3]=((fileMaxy-fileMiny)+500)/1000;
+                        screen=CALCULATEDBOUNDARIES;
+                        waitup=1;
+                        break;
+                    }
+                }
+                break;
+
             case LASERTEST: 
                 enable = !cfg->enable;
                 switch ( c ) {
@@ -82,6 +82,7 @@ private:
   // int x,y,z;
   // int xoff, yoff, zoff;
   FILE *runfile;
+  LaosReadAhead m_Reader; // read-ahead buffers of runfile
   LaosExtent m_Extent; // extent calculator
   int m_StageAfterAnalyzing;
   int m_SubStage;
@@ -27,6 +27,7 @@
 #include  "planner.h"
 #include  "stepper.h"
 #include  "pins.h"
+#include  <math.h>
 
 // #define DO_MOTION_TEST 1
 
@@ -36,6 +37,8 @@ int command=0;
 int mark_speed = 100; // 100 [mm/sec]
 int bitmap_speed = 100; // 100 [mm/sec]
 int power = 10000 ;
+int end_power = -1; // power at the end of the next line, ramped from power (-1: no ramp)
+int ppi = 0, pulse_length = 0; // pulse the laser on lines: pulses per inch (0: continuous), length [usec]
 // next planner action to enqueue
 tActionRequest  action;
 
@@ -46,12 +49,35 @@ static int ofsx=0, ofsy=0, ofsz=0;
 int param=0, val=0;
 
 // Bitmap buffer
-#define BITMAP_PIXELS  (8192)
-#define BITMAP_SIZE (BITMAP_PIXELS/32)
 unsigned long bitmap[BITMAP_SIZE];
 unsigned long bitmap_width=0; // nr of pixels
+volatile unsigned long bitmap_avail=0; // nr of pixels of the row in the buffer
+unsigned char bitmap_stream=0; // the row is streamed: wait for pixels that are not read yet
+volatile unsigned long bitmap_used=0; // streamed row: pixel the stepper reads, the ring holds the next ones
+static unsigned char bitmap_queued=0; // the streamed line is in the queue
 unsigned long bitmap_size=0; // nr of bytes
 unsigned char bitmap_bpp=1, bitmap_enable=0;
+unsigned char bitmap_dir=0; // 1: the rows are sent in +x order, play them reversed on lines in -x direction
+unsigned char bitmap_reverse=0; // read the current line from the last pixel
+long bitmap_shift=0; // nr of pixels the laser switches early on the current line
+long bitmap_start=0; // first pixel of the current line (after a trimmed blank start)
+unsigned long bitmap_count=0; // nr of pixels on the current line
+static long bitmap_on_first=-1, bitmap_on_last=-1; // first and last pixel that is on (-1: none)
+static long bitmap_run=0, bitmap_runs=0, bitmap_pos=0; // run length decoding: nr of runs, position
+
+// a word of bitmap data was stored at pixel base: update the pixels that are on
+static void bitmap_scan(unsigned long word, long base)
+{
+  if ( !bitmap_stream && (base >= BITMAP_PIXELS) ) return; // not stored
+  for (int b=0; word && (b < 32); b++, word >>= 1)
+  {
+    if ( (word & 1) && (base+b < (long)bitmap_width) )
+    {
+      if ( bitmap_on_first < 0 ) bitmap_on_first = base+b;
+      bitmap_on_last = base+b;
+    }
+  }
+}
 
 /**
 *** LaosMotion() Constructor
@@ -81,7 +107,7 @@ LaosMotion::LaosMotion()
   reset();
   mark_speed = cfg->speed;
   bitmap_speed = cfg->xspeed;
-  action.param = 0;
+  action.param = action.end_param = 0;
   action.target.x = action.target.y = action.target.z = action.target.e =0;
   action.target.feed_rate = 60*mark_speed;
 
@@ -135,6 +161,13 @@ void LaosMotion::reset()
   m_PlannedXAbsolute = 0;
   m_PlannedYAbsolute = 0;
   m_PlannedZAbsolute = 0;
+  bitmap_dir = 0;
+  end_power = -1;
+  ppi = cfg->lppi;
+  pulse_length = cfg->lpulse;
+  plan_set_ppi(cfg->lppi, cfg->lpulse);
+  stopStream();
+  m_MovePending = false;
   *laser = LASEROFF;
   enable = cfg->enable;
   cover.mode(PullUp);
@@ -199,7 +232,7 @@ void LaosMotion::moveToAbsoluteWithAbsoluteFeedrate(int x, int y, int z, int fee
   action.target.z = z/1000.0;
   action.ActionType = actiontype;
   action.target.feed_rate =  feedrate;
-  action.param = power;
+  action.param = action.end_param = power;
   plan_buffer_line(&action);
   UpdatePlannedCoordinates(&action);
    //printf("To buffer: %d, %d, %d, %d\n", x, y,z,speed);
@@ -212,6 +245,163 @@ void LaosMotion::UpdatePlannedCoordinates(const tActionRequest *action)
   m_PlannedZAbsolute = action->target.z * 1000.0;
 }
 
+/**
+*** setBitmapDirection()
+*** Set up the stepper for a bitmap line of dx, dy [um]: on lines in -x 
+*** direction, rows in +x order are read from the end, and the pixels are 
+*** shifted to make up for the delay of the laser.
+*** Only call when no bitmap line is queued.
+**/
+void LaosMotion::setBitmapDirection(int dx, int dy)
+{
+  extern GlobalConfig *cfg;
+  float len = sqrt((float)dx*dx + (float)dy*dy);
+  int shift = (dx < 0 ? cfg->lshiftneg : cfg->lshiftpos);
+  bitmap_reverse = bitmap_dir && (dx < 0);
+  bitmap_shift = (len > 0 ? (long)(shift * bitmap_width / len + 0.5) : 0);
+}
+
+/**
+*** deferMove()
+*** Hold a move (laser off) back instead of queueing it: consecutive moves
+*** are joined into one straight move to the last target. A run of blank
+*** bitmap rows becomes a single move to the next row that burns.
+**/
+void LaosMotion::deferMove(const tActionRequest *move)
+{
+  m_Move = *move;
+  m_MovePending = true;
+  UpdatePlannedCoordinates(move);
+}
+
+/**
+*** flushMove()
+*** Queue the move that is held back, call before anything else is queued
+**/
+void LaosMotion::flushMove()
+{
+  if ( !m_MovePending ) return;
+  m_MovePending = false;
+  plan_buffer_line(&m_Move);
+}
+
+/**
+*** finish()
+*** End of the job: a streamed bitmap row is cut short and the move that
+*** is held back is queued
+**/
+void LaosMotion::finish()
+{
+  stopStream();
+  flushMove();
+}
+
+/**
+*** bitmapLine()
+*** Queue a bitmap line from the planned position to line->target. A row
+*** without pixels on is a move. Blank pixels at the start and end of the
+*** row, except the distance the head needs to get up to speed, are moved
+*** over at the move speed. These moves are joined with the moves before 
+*** and after the line.
+**/
+void LaosMotion::bitmapLine(tActionRequest *line)
+{
+  extern GlobalConfig *cfg;
+  tActionRequest act = *line;
+  float x0 = m_PlannedXAbsolute / 1000.0, y0 = m_PlannedYAbsolute / 1000.0;
+  float dx = line->target.x - x0, dy = line->target.y - y0;
+  float len = sqrt(dx*dx + dy*dy);
+
+  if ( (bitmap_on_first < 0) || (len <= 0) || (bitmap_width == 0) ) // nothing to burn
+  {
+    act.ActionType = AT_MOVE;
+    act.target.feed_rate = 60 * cfg->speed;
+    deferMove(&act);
+    return;
+  }
+  setBitmapDirection(dx*1000.0, dy*1000.0); // no bitmap line is queued: the stepper does not use it
+
+  // pixels that are on, in the order of the line
+  long first = (bitmap_reverse ? bitmap_width-1-bitmap_on_last : bitmap_on_first);
+  long last = (bitmap_reverse ? bitmap_width-1-bitmap_on_first : bitmap_on_last);
+  long overscan = (long)((float)bitmap_speed*bitmap_speed / (2.0*cfg->xaccel) * bitmap_width / len) + 1;
+  long start = first - overscan, end = last + 1 + overscan;
+  if ( start < 0 ) start = 0;
+  if ( end > (long)bitmap_width ) end = bitmap_width;
+
+  act.ActionType = AT_MOVE;
+  act.target.feed_rate = 60 * cfg->speed;
+  if ( start > 0 )
+  {
+    act.target.x = x0 + dx * start / bitmap_width;
+    act.target.y = y0 + dy * start / bitmap_width;
+    deferMove(&act);
+  }
+  flushMove();
+  while ( queue() );// printf("-"); // wait for queue to empty
+  bitmap_start = start;
+  bitmap_count = end - start;
+  act.ActionType = AT_BITMAP;
+  act.target.feed_rate = line->target.feed_rate;
+  act.target.x = x0 + dx * end / bitmap_width;
+  act.target.y = y0 + dy * end / bitmap_width;
+  plan_set_accel(cfg->xaccel);
+  plan_buffer_line(&act);
+  UpdatePlannedCoordinates(&act);
+  while ( queue() ); // printf("*"); // wait for queue to empty
+  plan_set_accel(cfg->accel);
+  if ( end < (long)bitmap_width )
+  {
+    act = *line;
+    act.ActionType = AT_MOVE;
+    act.target.feed_rate = 60 * cfg->speed;
+    deferMove(&act);
+  }
+}
+
+/**
+*** stopStream()
+*** Stop waiting for the data of a streamed bitmap line, so the line can
+*** complete (with the laser off for the pixels that were not read).
+**/
+void LaosMotion::stopStream()
+{
+  bitmap_stream = 0;
+  bitmap_queued = 0;
+}
+
+/**
+*** streamLine()
+*** Start a streamed bitmap line when the ring is filled, or finish it after
+*** the last data: wait for the line to complete.
+**/
+void LaosMotion::streamLine(tActionRequest *line)
+{
+  extern GlobalConfig *cfg;
+  if ( !bitmap_queued )
+  {
+    float dx = line->target.x*1000.0 - m_PlannedXAbsolute;
+    float dy = line->target.y*1000.0 - m_PlannedYAbsolute;
+    flushMove();
+    while ( queue() ); // wait for queue to empty
+    setBitmapDirection(dx, dy);
+    bitmap_reverse = 0;
+    bitmap_start = 0;
+    bitmap_count = bitmap_width;
+    plan_set_accel(cfg->xaccel);
+    plan_buffer_line(line);
+    UpdatePlannedCoordinates(line);
+    bitmap_queued = 1;
+  }
+  if ( bitmap_avail == bitmap_width ) // all data is in
+  {
+    while ( queue() ); // wait for queue to empty
+    plan_set_accel(cfg->accel);
+    bitmap_stream = 0;
+    bitmap_queued = 0;
+  }
+}
+
 /**
 *** write()
 *** Write command and parameters to motion controller
@@ -249,13 +439,19 @@ void LaosMotion::write(int i)
                 action.target.y = (i-ofsy)/1000.0;;
                 step=0;
                 action.target.z = 0;
-                action.param = power;
+                action.param = action.end_param = power;
                 action.ActionType =  (command ? AT_LASER : AT_MOVE);
                 if ( bitmap_enable && (action.ActionType == AT_LASER))
                 {
                   action.ActionType = AT_BITMAP;
                   bitmap_enable = 0;
                 }
+                if ( command && (end_power >= 0) ) // ramp the power of this line
+                {
+                  if ( action.ActionType == AT_LASER )
+                    action.end_param = power = end_power;
+                  end_power = -1;
+                }
                 switch ( action.ActionType )
                 {
                   case AT_MOVE: action.target.feed_rate = 60 * cfg->speed; break;
@@ -266,17 +462,15 @@ void LaosMotion::write(int i)
                 }
                 
                 if ( action.ActionType == AT_BITMAP )
+                  bitmapLine(&action);
+                else if ( action.ActionType == AT_MOVE )
+                  deferMove(&action);
+                else
                 {
-                  while ( queue() );// printf("-"); // wait for queue to empty
-                  plan_set_accel(cfg->xaccel);
+                  flushMove();
                   plan_buffer_line(&action);
                   UpdatePlannedCoordinates(&action);
-                  while ( queue() ); // printf("*"); // wait for queue to empty
-                  plan_set_accel(cfg->accel);
                 }
-                else
-                  plan_buffer_line(&action);
-                  UpdatePlannedCoordinates(&action);
                 break;
             }
             break;
@@ -289,6 +483,7 @@ void LaosMotion::write(int i)
                 action.param = power;
                 action.ActionType =  AT_MOVE;
                 action.target.feed_rate =  60.0 * cfg->speed;
+                flushMove();
                 plan_buffer_line(&action);
                 UpdatePlannedCoordinates(&action);
                 break;
@@ -305,6 +500,7 @@ void LaosMotion::write(int i)
                 break;
               case 3:
                 z = i;
+                flushMove();
                 setPositionRelativeToOrigin(x,y,z);
                 step=0;
                 break;
@@ -339,6 +535,23 @@ void LaosMotion::write(int i)
                       printf("> power: %i\n",power);
                     #endif  
                     break;
+                  case 102:
+                    bitmap_dir = (val != 0);
+                    break;
+                  case 103:
+                    end_power = val;
+                    #ifdef READ_FILE_DEBUG
+                      printf("> end power: %i\n",end_power);
+                    #endif  
+                    break;
+                  case 104:
+                    ppi = (val > 0 ? val : 0);
+                    plan_set_ppi(ppi, pulse_length);
+                    break;
+                  case 105:
+                    pulse_length = (val > 0 ? val : 1);
+                    plan_set_ppi(ppi, pulse_length);
+                    break;
                 }
                 break;
             }
@@ -354,24 +567,115 @@ void LaosMotion::write(int i)
               while ( queue() );// printf("+"); // wait for queue to empty
               bitmap_width = i;
               bitmap_enable = 1;
+              bitmap_on_first = bitmap_on_last = -1;
               bitmap_size = (bitmap_bpp * bitmap_width) / 32;
               if  ( (bitmap_bpp * bitmap_width) % 32 )  // padd to next 32-bit
                 bitmap_size++;
+              bitmap_avail = min(bitmap_width, BITMAP_PIXELS);
+              if ( bitmap_width > BITMAP_PIXELS )
+                printf("Bitmap: row of %ld pixels, the pixels after %d are off (use command 11)\n\r", 
+                  bitmap_width, BITMAP_PIXELS);
               // printf("\n\rBitmap: read %d dwords\n\r", bitmap_size);
 
             }
             else if ( step > 2 )// copy data
             {
-              bitmap[ (step-3) % BITMAP_SIZE ] = i;
+              if ( step-3 < BITMAP_SIZE ) // wider rows do not fit
+                bitmap[ step-3 ] = i;
+              bitmap_scan(i, (step-3)*32);
               // printf("[%ld] = %ld\n", (step-3) % BITMAP_SIZE, i);
               if ( step-2 == bitmap_size ) // last dword received
               {
-                bitmap[ (step-2) % BITMAP_SIZE ] = 0;
+                if ( step-2 < BITMAP_SIZE ) bitmap[ step-2 ] = 0;
                 step = 0;
                 // printf("Bitmap: received %d dwords\n\r", bitmap_size);
               }
             }
             break;
+         case 10: // Store run length coded bitmap: 10 <width> <nr of runs> <run-0> ... <run-n>
+                  // runs alternate between laser off and on, starting with off
+            if ( step == 1 )
+            {
+              while ( queue() ); // wait for queue to empty
+              bitmap_bpp = 1;
+              bitmap_width = i;
+              bitmap_enable = 1;
+              bitmap_on_first = bitmap_on_last = -1;
+              bitmap_size = (bitmap_width + 31) / 32;
+              if ( bitmap_size > BITMAP_SIZE ) bitmap_size = BITMAP_SIZE;
+              bitmap_avail = min(bitmap_width, BITMAP_PIXELS);
+              memset(bitmap, 0, sizeof(bitmap));
+            }
+            else if ( step == 2 )
+            {
+              bitmap_runs = i;
+              bitmap_run = bitmap_pos = 0;
+              if ( bitmap_runs <= 0 ) step = 0;
+            }
+            else // decode the next run
+            {
+              long end = bitmap_pos + (i > 0 ? i : 0);
+              if ( end > (long)bitmap_width ) end = bitmap_width;
+              if ( end > BITMAP_PIXELS ) end = BITMAP_PIXELS;
+              if ( (bitmap_run & 1) && (end > bitmap_pos) )
+              {
+                if ( bitmap_on_first < 0 ) bitmap_on_first = bitmap_pos;
+                bitmap_on_last = end-1;
+                for (long p=bitmap_pos; p < end; p++)
+                  bitmap[p / 32] |= 1UL << (p % 32);
+              }
+              if ( end > bitmap_pos ) bitmap_pos = end;
+              if ( ++bitmap_run == bitmap_runs ) step = 0;
+            }
+            break;
+         case 11: // streamed bitmap line: 11 <x> <y> <bpp> <width> <data-0> <data-1> ... <data-n>
+                  // the line starts while the data is read, the row is in the order of the line
+            switch ( step )
+            {
+              case 1:
+                action.target.x = (i-ofsx)/1000.0;
+                break;
+              case 2:
+                action.target.y = (i-ofsy)/1000.0;
+                break;
+              case 3:
+                bitmap_bpp = i;
+                break;
+              case 4:
+                while ( queue() ); // wait for queue to empty
+                bitmap_width = i;
+                bitmap_size = (bitmap_bpp * bitmap_width + 31) / 32;
+                bitmap_stream = 1;
+                bitmap_avail = bitmap_used = 0;
+                bitmap_queued = 0;
+                action.target.z = 0;
+                action.param = power;
+                action.ActionType = AT_BITMAP;
+                action.target.feed_rate = 60 * bitmap_speed;
+                if ( bitmap_size == 0 )
+                {
+                  streamLine(&action);
+                  step = 0;
+                }
+                break;
+              default: // data
+              {
+                unsigned long word = step-5;
+                // ring full: wait for the stepper to pass the pixels that are overwritten
+                while ( bitmap_queued && ((word+1)*32 > bitmap_used + BITMAP_PIXELS) );
+                bitmap[ word % BITMAP_SIZE ] = i;
+                bitmap_avail = min((word+1)*32, bitmap_width);
+                if ( step-4 == bitmap_size ) // last dword received
+                {
+                  streamLine(&action);
+                  step = 0;
+                }
+                else if ( !bitmap_queued && ((word+1) % BITMAP_SIZE == 0) ) // ring filled: go
+                  streamLine(&action);
+                break;
+              }
+            }
+            break;
          default: // I do not understand: stop motion
             step = 0;
             break;
@@ -28,6 +28,10 @@
 #include "pins.h"
 #include  "planner.h"
 
+// Bitmap buffer: a row, or for streamed rows the ring of pixels that are ahead of the head
+#define BITMAP_PIXELS  (8192)
+#define BITMAP_SIZE (BITMAP_PIXELS/32)
+
     /** Motion Controll system
       *
       * Example:
@@ -44,6 +48,8 @@ public:
   void write(int i); // write command word to motion controller
   int ready(); // returns true if we are ready to accept a new instruction
   void reset(); // reset the instruction decoder and motion controller
+  void stopStream(); // a streamed bitmap row is cut short (cancel, end of file): the rest stays off
+  void finish(); // end of the job: queue the move that is held back
   void home(int xhome, int yhome, int zhome); // home the system, move to the sensors and set the specified position
   bool isStart(); // start button is enabled
   bool isHome; // system is homed
@@ -64,7 +70,14 @@ public:
   void UpdatePlannedCoordinates(const tActionRequest *action);
 
 private:
+  void setBitmapDirection(int dx, int dy); // set up the stepper for a bitmap line
+  void bitmapLine(tActionRequest *line); // queue a bitmap line
+  void streamLine(tActionRequest *line); // queue a streamed bitmap line
+  void deferMove(const tActionRequest *move); // hold a move back to join it with the next one
+  void flushMove(); // queue the move that is held back
   int m_PlannedXAbsolute, m_PlannedYAbsolute, m_PlannedZAbsolute; // in absolute coordinates
+  tActionRequest m_Move; // move that is held back
+  bool m_MovePending;
 
 };
 
@@ -38,8 +38,6 @@ config_t config;
 
 #define lround(x) ( (long)floor(x+0.5) )
 
-// The number of linear motions that can be in the plan at any give time
-#define BLOCK_BUFFER_SIZE 16
 tTarget startpoint;
 
 static block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
@@ -54,6 +52,10 @@ static uint8_t acceleration_manager_enabled;   // Acceleration management active
 
 static float rounde[NUM_AXES]; // Rounding errors.
 
+static float pulses_per_mm = 0; // PPI mode: laser pulses per mm on lines (0: continuous)
+static float pulse_round = 0;   // fraction of a pulse left at the end of the previous line
+static uint16_t pulse_length = 0; // [usec]
+
 
 // initial entry point of the planner
 // Clear values and set defaults
@@ -103,6 +105,13 @@ void plan_set_accel(float a)
   config.acceleration = a;
 }
 
+void plan_set_ppi(int ppi, int pulse_us)
+{
+  pulses_per_mm = (ppi > 0 ? ppi / 25.4 : 0);
+  pulse_length = pulse_us;
+  pulse_round = 0;
+}
+
 
 // Returns the index of the next block in the ring buffer
 // NOTE: Removed modulo (%) operator, which uses an expensive divide and multiplication.
@@ -155,6 +164,89 @@ static float max_allowable_speed(float acceleration, float target_velocity, floa
   return( sqrt(target_velocity*target_velocity-2*acceleration*60*60*distance) );
 }
 
+float plan_max_allowable_speed(float acceleration, float target_velocity, float distance) {
+  return max_allowable_speed(acceleration, target_velocity, distance);
+}
+
+
+// Returns the factor that converts the path vector delta_mm [mm] to the speed per axis [mm/min]
+// for a move at feed_rate, reduced so that no axis exceeds its maximum feed rate.
+float plan_speed_multiplier(float *delta_mm, float millimeters, float feed_rate) {
+  float speed_x, speed_y, speed_z, speed_e; // Nominal mm/minute for each axis  
+//
+// Speed limit code from Marlin firmware
+//
+  float microseconds;
+  //if(feedrate<minimumfeedrate)
+  //  feedrate=minimumfeedrate;
+  microseconds = lround((millimeters/feed_rate*60.0)*1000000.0);
+
+  // Calculate speed in mm/minute for each axis
+  float multiplier = 60.0*1000000.0/(float)microseconds;
+  speed_x = delta_mm[X_AXIS] * multiplier;
+  speed_y = delta_mm[Y_AXIS] * multiplier;
+  speed_z = delta_mm[Z_AXIS] * multiplier;
+  speed_e = delta_mm[E_AXIS] * multiplier;
+
+  // Limit speed per axis
+  float speed_factor = 1; //factor <=1 do decrease speed
+  if(fabs(speed_x) > config.maximum_feedrate_x) 
+  {
+    speed_factor = (float)config.maximum_feedrate_x / fabs(speed_x);
+  }
+  if(fabs(speed_y) > config.maximum_feedrate_y)
+  {
+    float tmp_speed_factor = (float)config.maximum_feedrate_y / fabs(speed_y);
+    if(speed_factor > tmp_speed_factor) speed_factor = tmp_speed_factor;
+  }
+  if(fabs(speed_z) > config.maximum_feedrate_z)
+  {
+    float tmp_speed_factor = (float)config.maximum_feedrate_z / fabs(speed_z);
+    if(speed_factor > tmp_speed_factor) speed_factor = tmp_speed_factor;
+  }
+  if(fabs(speed_e) > config.maximum_feedrate_e)
+  {
+    float tmp_speed_factor = (float)config.maximum_feedrate_e / fabs(speed_e);
+    if(speed_factor > tmp_speed_factor) speed_factor = tmp_speed_factor;
+  }
+
+  return multiplier * speed_factor;
+}
+
+
+// Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
+// Let a circle be tangent to both previous and current path line segments, where the junction 
+// deviation is defined as the distance from the junction to the closest edge of the circle, 
+// colinear with the circle center. The circular segment joining the two paths represents the 
+// path of centripetal acceleration. Solve for max velocity based on max acceleration about the
+// radius of the circle, defined indirectly by junction deviation. This may be also viewed as 
+// path width or max_jerk in the previous grbl version. This approach does not actually deviate 
+// from path, but used as a robust way to compute cornering speeds, as it takes into account the
+// nonlinearities of both the junction angle and junction velocity.
+float plan_junction_speed(float *prev_unit_vec, float prev_nominal_speed, float *unit_vec, 
+  float nominal_speed, float acceleration) {
+  float vmax_junction = MINIMUM_PLANNER_SPEED; // Set default max junction speed
+
+  // Compute cosine of angle between previous and current path. (prev_unit_vec is negative)
+  // NOTE: Max junction velocity is computed without sin() or acos() by trig half angle identity.
+  float cos_theta = - prev_unit_vec[X_AXIS] * unit_vec[X_AXIS] 
+                     - prev_unit_vec[Y_AXIS] * unit_vec[Y_AXIS] 
+                     - prev_unit_vec[Z_AXIS] * unit_vec[Z_AXIS] ;
+                       
+  // Skip and use default max junction speed for 0 degree acute junction.
+  if (cos_theta < 0.95) {
+    vmax_junction = min(prev_nominal_speed,nominal_speed);
+    // Skip and avoid divide by zero for straight junctions at 180 degrees. Limit to min() of nominal speeds.
+    if (cos_theta > -0.95) {
+      // Compute maximum junction velocity based on maximum acceleration and junction deviation
+      float sin_theta_d2 = sqrt(0.5*(1.0-cos_theta)); // Trig half angle identity. Always positive.
+      vmax_junction = min(vmax_junction,
+        sqrt(acceleration*60*60 * config.junction_deviation * sin_theta_d2/(1.0-sin_theta_d2)) );
+    }
+  }
+  return vmax_junction;
+}
+
 
 // The kernel called by planner_recalculate() when scanning the plan from last to first entry.
 static void planner_reverse_pass_kernel(block_t *previous, block_t *current, block_t *next) {
@@ -373,7 +465,6 @@ void plan_buffer_line (tActionRequest *pAction)
   float z;
   float feed_rate;
   bool e_only = false;
-  float speed_x, speed_y, speed_z, speed_e; // Nominal mm/minute for each axis  
     
   x = pAction->target.x;
   y = pAction->target.y;
@@ -416,6 +507,7 @@ void plan_buffer_line (tActionRequest *pAction)
 
   block->action_type = AT_MOVE;
   block->power = pAction->param;
+  block->end_power = (pAction->ActionType == AT_LASER ? pAction->end_param : pAction->param);
   
   // Compute direction bits for this block
   block->direction_bits = 0;
@@ -450,48 +542,7 @@ void plan_buffer_line (tActionRequest *pAction)
   }
   float inverse_millimeters = 1.0/block->millimeters;  // Inverse millimeters to remove multiple divides    
   
-//
-// Speed limit code from Marlin firmware
-//
-  float microseconds;
-  //if(feedrate<minimumfeedrate)
-  //  feedrate=minimumfeedrate;
-  microseconds = lround((block->millimeters/feed_rate*60.0)*1000000.0);
-
-  // Calculate speed in mm/minute for each axis
-  float multiplier = 60.0*1000000.0/(float)microseconds;
-  speed_x = delta_mm[X_AXIS] * multiplier;
-  speed_y = delta_mm[Y_AXIS] * multiplier;
-  speed_z = delta_mm[Z_AXIS] * multiplier;
-  speed_e = delta_mm[E_AXIS] * multiplier;
-
-  // Limit speed per axis
-  float speed_factor = 1; //factor <=1 do decrease speed
-  if(fabs(speed_x) > config.maximum_feedrate_x) 
-  {
-    speed_factor = (float)config.maximum_feedrate_x / fabs(speed_x);
-  }
-  if(fabs(speed_y) > config.maximum_feedrate_y)
-  {
-    float tmp_speed_factor = (float)config.maximum_feedrate_y / fabs(speed_y);
-    if(speed_factor > tmp_speed_factor) speed_factor = tmp_speed_factor;
-  }
-  if(fabs(speed_z) > config.maximum_feedrate_z)
-  {
-    float tmp_speed_factor = (float)config.maximum_feedrate_z / fabs(speed_z);
-    if(speed_factor > tmp_speed_factor) speed_factor = tmp_speed_factor;
-  }
-  if(fabs(speed_e) > config.maximum_feedrate_e)
-  {
-    float tmp_speed_factor = (float)config.maximum_feedrate_e / fabs(speed_e);
-    if(speed_factor > tmp_speed_factor) speed_factor = tmp_speed_factor;
-  }
-
-  multiplier = multiplier * speed_factor;
-  speed_x = delta_mm[X_AXIS] * multiplier;
-  speed_y = delta_mm[Y_AXIS] * multiplier;
-  speed_z = delta_mm[Z_AXIS] * multiplier;
-  speed_e = delta_mm[E_AXIS] * multiplier;
+  float multiplier = plan_speed_multiplier(delta_mm, block->millimeters, feed_rate);
   block->nominal_speed = block->millimeters * multiplier;    // mm per min
   block->nominal_rate = ceil(block->step_event_count * multiplier);   // steps per minute
 
@@ -516,36 +567,12 @@ void plan_buffer_line (tActionRequest *pAction)
     unit_vec[Y_AXIS] = delta_mm[Y_AXIS]*inverse_millimeters;
     unit_vec[Z_AXIS] = delta_mm[Z_AXIS]*inverse_millimeters;  
   
-    // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
-    // Let a circle be tangent to both previous and current path line segments, where the junction 
-    // deviation is defined as the distance from the junction to the closest edge of the circle, 
-    // colinear with the circle center. The circular segment joining the two paths represents the 
-    // path of centripetal acceleration. Solve for max velocity based on max acceleration about the
-    // radius of the circle, defined indirectly by junction deviation. This may be also viewed as 
-    // path width or max_jerk in the previous grbl version. This approach does not actually deviate 
-    // from path, but used as a robust way to compute cornering speeds, as it takes into account the
-    // nonlinearities of both the junction angle and junction velocity.
     float vmax_junction = MINIMUM_PLANNER_SPEED; // Set default max junction speed
 
     // Skip first block or when previous_nominal_speed is used as a flag for homing and offset cycles.
     if ((block_buffer_head != block_buffer_tail) && (previous_nominal_speed > 0.0)) {
-      // Compute cosine of angle between previous and current path. (prev_unit_vec is negative)
-      // NOTE: Max junction velocity is computed without sin() or acos() by trig half angle identity.
-      float cos_theta = - previous_unit_vec[X_AXIS] * unit_vec[X_AXIS] 
-                         - previous_unit_vec[Y_AXIS] * unit_vec[Y_AXIS] 
-                         - previous_unit_vec[Z_AXIS] * unit_vec[Z_AXIS] ;
-                           
-      // Skip and use default max junction speed for 0 degree acute junction.
-      if (cos_theta < 0.95) {
-        vmax_junction = min(previous_nominal_speed,block->nominal_speed);
-        // Skip and avoid divide by zero for straight junctions at 180 degrees. Limit to min() of nominal speeds.
-        if (cos_theta > -0.95) {
-          // Compute maximum junction velocity based on maximum acceleration and junction deviation
-          float sin_theta_d2 = sqrt(0.5*(1.0-cos_theta)); // Trig half angle identity. Always positive.
-          vmax_junction = min(vmax_junction,
-            sqrt(config.acceleration*60*60 * config.junction_deviation * sin_theta_d2/(1.0-sin_theta_d2)) );
-        }
-      }
+      vmax_junction = plan_junction_speed(previous_unit_vec, previous_nominal_speed, unit_vec, 
+        block->nominal_speed, config.acceleration);
     }
     block->max_entry_speed = vmax_junction;
     
@@ -587,6 +614,19 @@ void plan_buffer_line (tActionRequest *pAction)
     block->options = OPT_BITMAP;
   else
     block->options = 0;
+
+  // PPI mode: the pulses of this line, the remaining fraction carries over to the next line
+  block->pulses = 0;
+  block->pulse_us = pulse_length;
+  if ( (block->options & OPT_LASER_ON) && (pulses_per_mm > 0) )
+  {
+    block->options |= OPT_PPI; // also when no whole pulse falls in this block
+    float pulses = block->millimeters * pulses_per_mm + pulse_round;
+    block->pulses = (uint32_t)pulses;
+    pulse_round = pulses - block->pulses;
+    if ( block->pulses > block->step_event_count ) // at most one pulse per step event
+      block->pulses = block->step_event_count;
+  }
   
   // now that the options are set: make this a MOVE action.
   pAction->ActionType = AT_MOVE;
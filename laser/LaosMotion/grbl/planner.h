@@ -24,6 +24,9 @@
                  
 #include <inttypes.h>
 
+// The number of linear motions that can be in the plan at any give time
+#define BLOCK_BUFFER_SIZE 16
+
 typedef enum {
   AT_MOVE,         // move with laser off
   AT_LASER,        // move with laser on
@@ -48,6 +51,7 @@ typedef  struct {
 #define OPT_HOME_Z   16
 #define OPT_HOME_E   32
 #define OPT_BITMAP   64 // bitmap mark a line
+#define OPT_PPI     128 // pulse the laser (with OPT_LASER_ON), see pulses
 
 
 // This struct is used when buffering the setup for each linear movement "nominal" values are as specified in 
@@ -82,6 +86,9 @@ typedef struct
   uint8_t check_endstops; // for homing moves
   uint8_t options; // for further options (e.g. laser on/off, homing on axis, dwell, etc)  
   uint16_t power; // laser power setpoint
+  uint16_t end_power; // laser power at the end of the block (ramped from power)
+  uint32_t pulses; // laser on lines in PPI mode (OPT_PPI): nr of pulses in this block
+  uint16_t pulse_us; // length of a pulse [usec]
 } block_t;
 
 // This defines an action to enque, with its target position
@@ -89,6 +96,7 @@ typedef struct {
   eActionType ActionType;
   tTarget     target;  
   uint16_t    param; // argument for the action
+  uint16_t    end_param; // AT_LASER: power at the end of the line (param is the power at the start)
 } tActionRequest;
 
 
@@ -98,6 +106,8 @@ extern tTarget startpoint;
 // Initialize the motion plan subsystem      
 void plan_init();
 void plan_set_accel(float a);
+// Pulse the laser on the lines that follow: pulses per inch (0: continuous) and pulse length [usec]
+void plan_set_ppi(int ppi, int pulse_us);
 
 // Add a new linear movement to the buffer. x, y and z is the signed, absolute target position in 
 // millimeters. Feed rate specifies the speed of the motion. (in mm/min) 
@@ -105,6 +115,16 @@ void plan_buffer_line (tActionRequest *pAction);
 
 void plan_buffer_action(tActionRequest *pAction);
 
+// The speed limits of plan_buffer_line(), for a job time estimate (see LaosEstimator). Speeds 
+// in [mm/min], acceleration in [mm/sec2].
+// Factor from the path vector [mm] to the speed of each axis, limited by the axis feed rates
+float plan_speed_multiplier(float *delta_mm, float millimeters, float feed_rate);
+// Maximum speed at the junction of two moves with the given unit vectors
+float plan_junction_speed(float *prev_unit_vec, float prev_nominal_speed, float *unit_vec, 
+  float nominal_speed, float acceleration);
+// Maximum speed at which target_velocity can still be reached within distance
+float plan_max_allowable_speed(float acceleration, float target_velocity, float distance);
+
 // Called when the current block is no longer needed. Discards the block and makes the memory
 // availible for new blocks.
 void plan_discard_current_block();
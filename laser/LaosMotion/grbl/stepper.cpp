@@ -31,6 +31,7 @@
 */
 #include <LaosMotion.h>
 #include "pins.h"
+#include "us_ticker_api.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -61,10 +62,15 @@ volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e; // actual position
 static block_t *current_block;  // A pointer to the block currently being traced
 static Ticker timer; // the periodic timer used to step
 static Timeout exhaust_timer; // air assist/exhaust turn off delay
+static Timeout pulse_timer; // PPI mode: end of the laser pulse
 static tFixedPt pwmofs; // the offset of the PWM value
 static tFixedPt pwmscale; // the scaling of the PWM value
 static volatile int running = 0;  // stepper irq is running
 static uint32_t s_CurrentTimerPeriod = 2000;
+#define LOAD_WINDOW 1000000 // the step interrupt load is measured over windows of this length [usec]
+static volatile uint32_t isr_time = 0; // time spent in st_interrupt() in the current window [usec]
+static volatile uint32_t load_start = 0; // start of the current window [usec]
+static volatile int load = 0; // load of the last complete window [%]
 
 static uint32_t direction_inv;    // invert mask for direction bits
 static uint32_t direction_bits;   // all axes direction (different ports)
@@ -74,6 +80,10 @@ static int32_t counter_x,       // Counter variables for the bresenham line trac
                counter_y,
                counter_z;
 static int32_t counter_e, counter_l, pos_l; // extruder and laser
+static int32_t power_l, counter_p;  // laser power, Bresenham counter of the power ramp
+static int32_t counter_pulse;       // PPI mode: Bresenham counter of the laser pulses
+static int32_t ramp_q, ramp_r, ramp_dir; // power ramp: change per step event, remainder, direction
+static float pwm_ofs, pwm_gain;     // pwm at power 0, pwm per unit of power
 static uint32_t step_events_completed; // The number of step events executed in the current block
 
 // Variables used by the trapezoid generation
@@ -86,10 +96,20 @@ static tFixedPt  c;          // current clock cycle count [1/speed]
 static int32_t   c_min;      // minimal clock cycle count [at vnominal for this block]
 static int32_t   n;
 static int32_t   decel_n;
+static int32_t   max_n;       // n at the nominal rate: nr of step events to reach it from standstill
 static tRamp     ramp;        // state of state machine for ramping up/down
 
 extern unsigned char bitmap_bpp;
 extern unsigned long bitmap[], bitmap_width, bitmap_size;
+extern unsigned char bitmap_reverse;
+extern long bitmap_shift, bitmap_start;
+extern unsigned long bitmap_count;
+extern volatile unsigned long bitmap_avail, bitmap_used;
+extern unsigned char bitmap_stream;
+static volatile unsigned long underruns = 0; // streamed bitmap rows: steps waited for data
+static unsigned char stream_block = 0; // the current block is a streamed bitmap row
+static uint32_t stream_spp; // streamed row: step events per pixel (times 256)
+#define STREAM_MARGIN 8 // streamed row: brake this many step events early, speed up with twice this many ahead
 
 
 //         __________________________
@@ -133,6 +153,9 @@ void st_init(void)
   else
     pwmscale = div_f(to_fixed(cfg->pwmmax - cfg->pwmmin), to_fixed(100) );
   printf("ofs: %lu, scale: %lu\n", pwmofs, pwmscale);
+  pwm_ofs = cfg->pwmmin/100.0;
+  pwm_gain = (cfg->pwmmax - cfg->pwmmin)/(100.0*10000.0);
+  power_l = 0;
   actpos_x = actpos_y = actpos_z = actpos_e = 0;
   st_wake_up();
   trapezoid_tick_cycle_counter = 0;
@@ -255,6 +278,7 @@ static inline void trapezoid_generator_reset()
   ramp = RAMP_UP;
 
   accel_until = calc_n (current_block->nominal_rate/60.0, alpha, accel);
+  max_n = accel_until;
   c_min = c0 * (sqrt(accel_until+1.0)-sqrt((float)accel_until));
   accel_until = accel_until - n;
 
@@ -280,11 +304,32 @@ static inline void trapezoid_generator_reset()
 //  return (TICKS_PER_MICROSECOND*1000000*6) / cycles * 10;
 //}
 
+// Close the window of the load measurement when it is complete, so the
+// sums stay far from wrapping (call with the step interrupt blocked)
+static inline void update_load(uint32_t now)
+{
+  uint32_t period = now - load_start;
+  if ( period < LOAD_WINDOW ) return;
+  load = (int)(((uint64_t)isr_time * 100) / period);
+  isr_time = 0;
+  load_start = now;
+}
+
+// PPI mode: end of a laser pulse
+static void pulse_off()
+{
+  *laser = LASEROFF;
+}
+
+// Set the pwm for a laser power of 0..10000
+static inline void set_laser_power(int32_t power)
+{
+  pwm = pwm_ofs + power * pwm_gain;
+}
+
 // Set the step timer. Note: this starts the ticker at an interval of "cycles"
 static inline void set_step_timer (uint32_t cycles)
 {
-   extern GlobalConfig *cfg;
-   volatile static double p;
    if(s_CurrentTimerPeriod != cycles)
    {
      s_CurrentTimerPeriod = cycles;
@@ -294,11 +339,38 @@ static inline void set_step_timer (uint32_t cycles)
   // p = (60E6/nominal_rate) / cycles; // nom_rate is steps/minute,
    //printf("%f,%f,%f\n\r", (float)(60E6/nominal_rate), (float)cycles, (float)p);
   // printf("%d: %f %f\n\r", (int)current_block->power, (float)p, (float)c_min/(float(c) ));
-     p = (double)(cfg->pwmmin/100.0 + ((current_block->power/10000.0)*((cfg->pwmmax - cfg->pwmmin)/100.0)));
-     pwm = p;
+     if ( stream_block && (cycles > (uint32_t)to_int(c_min)) )
+       set_laser_power(power_l * to_int(c_min) / (int32_t)cycles); // streamed row: power follows the speed
+     else
+       set_laser_power(power_l);
    }
 }
 
+// Streamed bitmap row: brake in time for the end of the line and for the
+// first pixel that is not read yet, and speed up again when it is read.
+// The speed is kept as the nr of step events it takes to stop (n).
+static inline void stream_ramp(void)
+{
+  int32_t speed_n = (ramp == RAMP_DOWN ? -n : (ramp == RAMP_MAX ? max_n : n));
+  uint32_t left = current_block->step_event_count - step_events_completed;
+  if ( bitmap_stream && (bitmap_avail < bitmap_width) )
+  {
+    long ahead = (long)bitmap_avail - (long)(bitmap_start + pos_l + bitmap_shift); // pixels
+    uint32_t steps = ( ahead > 0 ? (uint32_t)(((uint64_t)ahead * stream_spp) >> 8) : 0 );
+    if ( steps < left ) left = steps;
+  }
+  if ( (ramp != RAMP_DOWN) && (left <= (uint32_t)speed_n + STREAM_MARGIN) )
+  {
+    ramp = RAMP_DOWN;
+    n = -speed_n;
+  }
+  else if ( (ramp == RAMP_DOWN) && (left > (uint32_t)speed_n + 2*STREAM_MARGIN) )
+  {
+    ramp = RAMP_UP;
+    n = speed_n;
+  }
+}
+
 // "The Stepper Driver Interrupt" - This timer interrupt is the workhorse of Grbl. It is  executed at the rate set with
 // set_step_timer. It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
 // It is supported by The Stepper Port Reset Interrupt which it uses to reset the stepper port after each pulse.
@@ -310,6 +382,7 @@ static  void st_interrupt (void)
 
   if(busy){ /*printf("busy!\n"); */ return; } // The busy-flag is used to avoid reentering this interrupt
   busy = 1;
+  uint32_t isr_start = us_ticker_read();
 
   // Set the direction pins a cuple of nanoseconds before we step the steppers
   //STEPPING_PORT = (STEPPING_PORT & ~DIRECTION_MASK) | (out_bits & DIRECTION_MASK);
@@ -326,13 +399,36 @@ static  void st_interrupt (void)
     // Anything in the buffer?
     current_block = plan_get_current_block();
     if (current_block != NULL) {
+      // a pulse of the previous block must not carry over into this one
+      pulse_timer.detach();
+      if ( current_block->options & OPT_PPI )
+        *laser = LASEROFF;
+      stream_block = ( (current_block->options & OPT_BITMAP) && bitmap_stream && bitmap_count );
       trapezoid_generator_reset();
+      if ( stream_block )
+      {
+        // stream_ramp() decides when to slow down
+        current_block->decelerate_after = current_block->step_event_count;
+        stream_spp = ((uint64_t)current_block->step_event_count << 8) / bitmap_count;
+      }
       counter_x = -(current_block->step_event_count >> 1);
       counter_y = counter_x;
       counter_z = counter_x;
       counter_e = counter_x;
       counter_l = counter_x;
       pos_l = 0; // reset laser bitmap counter
+      counter_pulse = counter_x;
+      power_l = current_block->power;
+      if ( current_block->end_power != current_block->power )
+      {
+        // ramp the power over the step events: Bresenham with the quotient and remainder
+        int32_t delta = (int32_t)current_block->end_power - (int32_t)current_block->power;
+        ramp_dir = (delta < 0 ? -1 : 1);
+        ramp_q = delta / (int32_t)current_block->step_event_count;
+        ramp_r = labs(delta % (int32_t)current_block->step_event_count);
+        counter_p = counter_x;
+        set_laser_power(power_l);
+      }
       step_events_completed = 0;
       direction_bits = current_block->direction_bits ^ direction_inv;
       set_direction_pins ();
@@ -351,8 +447,31 @@ static  void st_interrupt (void)
    // this block is a bitmap engraving line, read laser on/off status from buffer
    if ( current_block->options & OPT_BITMAP )
    {
-      *laser =  ! (bitmap[pos_l / 32] & (1 << (pos_l % 32)));
-      counter_l += bitmap_width;
+      // pixel under the head, bitmap_shift pixels ahead for the delay of the laser
+      unsigned long p = bitmap_start + pos_l + bitmap_shift;
+      if ( bitmap_reverse ) p = bitmap_width - 1 - p;
+      if ( (p >= bitmap_avail) && (p < bitmap_width) && bitmap_stream )
+      {
+        // streamed row: this pixel is not read yet. stream_ramp() brought the
+        // head down to the lowest speed, hold it (and the laser off) until
+        // the pixel is read, rather than burn the wrong pixel
+        *laser = LASEROFF;
+        underruns++;
+        step_bits = 0;
+        clear_all_step_pins ();
+        isr_time += us_ticker_read() - isr_start;
+        update_load(us_ticker_read());
+        busy = 0;
+        return;
+      }
+      if ( p < bitmap_avail ) // also when p went below 0
+      {
+        *laser =  ! (bitmap[(p / 32) % BITMAP_SIZE] & (1 << (p % 32)));
+        bitmap_used = p;
+      }
+      else
+        *laser = LASEROFF;
+      counter_l += bitmap_count;
      //  printf("%d %d %d: %d %d %c\n\r", bitmap_width, pos_l, counter_l,  pos_l / 32, pos_l % 32, (*laser ?  '1' : '0' ));
       if (counter_l > 0)
       {
@@ -361,6 +480,18 @@ static  void st_interrupt (void)
         pos_l++;
       }
    }
+   else if ( current_block->options & OPT_PPI )
+   {
+     // PPI mode: spread the pulses over the step events, the timer switches the laser off.
+     // The laser stays off in a block without pulses.
+     counter_pulse += current_block->pulses;
+     if (counter_pulse > 0)
+     {
+       counter_pulse -= current_block->step_event_count;
+       *laser = LASERON;
+       pulse_timer.attach_us(&pulse_off, current_block->pulse_us);
+     }
+   }
    else
    {
      *laser = ( current_block->options & OPT_LASER_ON ? LASERON : LASEROFF);
@@ -396,6 +527,17 @@ static  void st_interrupt (void)
         counter_e -= current_block->step_event_count;
       }
 
+      // power ramp: reaches end_power at the last step event
+      if (current_block->end_power != current_block->power) {
+        power_l += ramp_q;
+        counter_p += ramp_r;
+        if (counter_p > 0) {
+          power_l += ramp_dir;
+          counter_p -= current_block->step_event_count;
+        }
+        set_laser_power(power_l);
+      }
+
       //clear_step_pins (); // clear the pins, assume that we spend enough CPU cycles in the previous statements for the steppers to react (>1usec)
       if (cfg->pulse_us)
 	  	wait_us(cfg->pulse_us);
@@ -420,6 +562,9 @@ static  void st_interrupt (void)
       {
         tFixedPt new_c;
 
+        if ( stream_block )
+          stream_ramp();
+
         switch (ramp)
         {
           case RAMP_UP:
@@ -450,6 +595,11 @@ static  void st_interrupt (void)
           break;
 
           case RAMP_DOWN:
+            if ( stream_block && (n >= -1) )
+            {
+              n = -2; // streamed row: go on at the lowest speed up to the pixel that is not read yet
+              break;
+            }
             new_c = c - (c<<1) / (4*n+1);
             set_step_timer (to_int(new_c));
             c = new_c;
@@ -460,6 +610,7 @@ static  void st_interrupt (void)
       } else {
         // If current block is finished, reset pointer
         current_block = NULL;
+        stream_block = 0;
         plan_discard_current_block();
       }
     }
@@ -472,11 +623,29 @@ static  void st_interrupt (void)
   }
 
   clear_all_step_pins (); // clear the pins, assume that we spend enough CPU cycles in the previous statements for the steppers to react (>1usec)
+  isr_time += us_ticker_read() - isr_start;
+  update_load(us_ticker_read());
   busy=0;
 
 }
 
 
+// Return the nr of steps the stepper waited for the data of streamed bitmap rows
+unsigned long st_get_underruns()
+{
+  return underruns;
+}
+
+// Return the load of the step interrupt: the percentage of time spent in
+// st_interrupt() in the last complete window
+int st_get_load()
+{
+  __disable_irq();
+  update_load(us_ticker_read());
+  __enable_irq();
+  return load;
+}
+
 // Block until all buffered steps are executed
 void st_synchronize()
 {
@@ -114,6 +114,12 @@ void st_wake_up();
 // leave exhaust running after job completes.
 void exhaust_off();
 
+// percentage of time spent in the step interrupt (over the last second)
+int st_get_load();
+
+// nr of steps the stepper waited for the data of streamed bitmap rows
+unsigned long st_get_underruns();
+
 void st_debug_block(const block_t *block);
 
 void st_debug();
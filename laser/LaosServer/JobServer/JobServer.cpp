@@ -0,0 +1,194 @@
+/*
+ * JobServer.cpp
+ * Simple TCP job server
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "JobServer.h"
+
+// create a new job server listening on port (0: disabled)
+JobServer::JobServer(int myport) {
+    port = myport;
+    fp = NULL;
+    filecnt = 0;
+    strcpy(filename, "");
+    if (port == 0) {
+        state = jobdisabled;
+        return;
+    }
+    printf("JobServer(): port=%d\n", port);
+    state = jobidle;
+    if (server.bind(port) || server.listen())
+        state = joberror;
+    server.set_blocking(false, 1);
+}
+
+JobServer::~JobServer() {
+    if (fp != NULL)
+        fclose(fp);
+    conn.close();
+    server.close();
+}
+
+// get current server status
+JobServerState JobServer::State() {
+    return state;
+}
+
+// Name of the current (or most recently received) file
+void JobServer::getFilename(char* name) {
+    sprintf(name, "%s", filename);
+}
+
+// Return number of received files
+int JobServer::fileCnt() {
+    return filecnt;
+}
+
+// Poll for data or new connection
+void JobServer::poll() {
+    extern Timer systime;
+    switch (state) {
+        case jobidle:
+            if (server.accept(conn) == 0) {
+                conn.set_blocking(false, 1);
+                hdrlen = 0;
+                received = 0;
+                last_activity = systime.read_us();
+                state = jobheader;
+            }
+            break;
+
+        case jobheader:
+        case jobreceiving: {
+            char *p = (state == jobheader ? &buff[hdrlen] : buff);
+            int len = conn.receive(p, (state == jobheader ? JOBSERVER_BUFSIZE-1-hdrlen : JOBSERVER_BUFSIZE));
+            if (len < 0) { // nothing received
+                if (((unsigned int)systime.read_us() - last_activity) / 1000 > JOBSERVER_TIMEOUT)
+                    Err("timeout");
+                return;
+            }
+            if (len == 0) { // connection closed by the client
+                if ((state == jobreceiving) && (size == 0))
+                    finish();
+                else
+                    Err("connection closed");
+                return;
+            }
+            last_activity = systime.read_us();
+            if (state == jobreceiving) {
+                writeData(buff, len);
+                return;
+            }
+            // header: wait for the newline
+            hdrlen += len;
+            buff[hdrlen] = 0;
+            char *nl = strchr(buff, '\n');
+            if (nl == NULL) {
+                if (hdrlen >= JOBSERVER_BUFSIZE-1)
+                    Err("header too long");
+                return;
+            }
+            *nl++ = 0;
+            int datalen = hdrlen - (nl - buff);
+            if (!openFile())
+                return;
+            state = jobreceiving;
+            if (datalen > 0)
+                writeData(nl, datalen);
+            break;
+        }
+
+        case jobdisabled:
+        case joberror:
+            break;
+    }
+}
+
+// parse the header line in buff: open the file
+int JobServer::openFile() {
+    extern LaosFileSystem sd;
+    char name[JOBSERVER_BUFSIZE];
+    size = 0;
+    if (sscanf(buff, "%s %d", name, &size) < 1) {
+        Err("no filename");
+        return 0;
+    }
+    if (size < 0)
+        size = 0;
+    name[MAXFILESIZE-1] = 0;
+    strcpy(filename, name);
+    sd.shorten(filename, MAXFILESIZE);
+    fp = sd.openfile(filename, "wb");
+    if (fp == NULL) {
+        Err("could not open file to write");
+        return 0;
+    }
+    analyzer.start(filename);
+    printf("JobServer: receiving %s (%d bytes)\n", filename, size);
+    return 1;
+}
+
+// write received data to the file, finish if complete
+void JobServer::writeData(char *data, int len) {
+    if (size && (received + len > size))
+        len = size - received; // ignore trailing garbage
+    if ((int)fwrite(data, 1, len, fp) != len) {
+        Err("write error");
+        return;
+    }
+    analyzer.write(data, len);
+    received += len;
+    if (size && (received == size)) {
+        char ok[] = "OK\n";
+        conn.send_all(ok, strlen(ok));
+        finish();
+    }
+}
+
+// close the file and the connection
+void JobServer::finish() {
+    extern LaosFileSystem sd;
+    fclose(fp);
+    fp = NULL;
+    if (optimizejob(filename))
+        indexjob(filename);     // the paths were reordered: analyze again
+    else
+        analyzer.finish(filename);
+    sd.addjob(filename);
+    conn.close();
+    filecnt++;
+    state = jobidle;
+    printf("JobServer: received %s (%d bytes)\n", filename, received);
+}
+
+// send an error to the client, drop the connection and the partial file
+void JobServer::Err(const char *msg) {
+    char err[64];
+    printf("JobServer: Err(%s)\n", msg);
+    snprintf(err, sizeof(err), "ERR %s\n", msg);
+    conn.send_all(err, strlen(err));
+    conn.close();
+    if (fp != NULL) {
+        fclose(fp);
+        fp = NULL;
+        removefile(filename);
+    }
+    state = jobidle;
+}
@@ -0,0 +1,102 @@
+/**
+ * JobServer.h
+ * Simple TCP job server
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Minimal TCP job server, an alternative to TFTP for large jobs
+ *      * Receive (simplecode) files via a plain TCP stream, spool them to SD
+ *      * Server handles only one connection at a time
+ *      * No lock-step: flow control is done by the TCP window, data is
+ *        only read as fast as it can be written to the SD card
+ *
+ * Protocol (client -> server):
+ *      <filename> [<size>]\n
+ *      <size bytes of job data>
+ * If a size is given, the server answers "OK\n" (or "ERR <msg>\n") after
+ * the last byte and closes the connection. Without a size, the file ends
+ * when the client closes the connection.
+ *
+ * Example:
+ * @code
+ * JobServer *jobsrv;
+ * ...
+ * jobsrv = new JobServer(cfg->jobport);
+ * ...
+ * jobsrv->poll();
+ * @endcode
+ *
+ */
+
+#ifndef _JOBSERVER_H_
+#define _JOBSERVER_H_
+
+#include <stdio.h>
+#include "mbed.h"
+#include "laosfilesystem.h"
+#include "laosjobindex.h"
+#include "laosoptimize.h"
+#include "EthernetInterface.h"
+#include "global.h"
+
+#define JOBSERVER_TIMEOUT 10000  // abort a connection when idle for this long [msec]
+#define JOBSERVER_BUFSIZE 1024   // receive buffer size [bytes]
+
+enum JobServerState { jobdisabled, jobidle, jobheader, jobreceiving, joberror };
+
+class JobServer {
+
+public:
+    // create a new job server listening on port (0: disabled)
+    JobServer(int myport);
+    ~JobServer();
+    // get current server status
+    JobServerState State();
+    // Poll for data or new connection
+    void poll();
+    // Name of the current (or most recently received) file
+    void getFilename(char* name);
+    // Return number of received files
+    int fileCnt();
+
+private:
+    // parse the header line in buff: open the file
+    int openFile();
+    // write received data to the file, finish if complete
+    void writeData(char *data, int len);
+    // close the file and the connection
+    void finish();
+    // send an error to the client, drop the connection and the partial file
+    void Err(const char *msg);
+
+    int port;                   // The TCP port
+    TCPSocketServer server;     // listening socket
+    TCPSocketConnection conn;   // current connection
+    JobServerState state;       // current server state
+    FILE* fp;                   // current file to write
+    char buff[JOBSERVER_BUFSIZE]; // receive buffer
+    int hdrlen;                 // nr of header bytes in buff
+    int size;                   // announced file size (0: until disconnect)
+    int received;               // nr of data bytes received
+    unsigned int last_activity; // systime [usec] of the last received data
+    char filename[MAXFILESIZE+1]; // current (or most recent) filename
+    int filecnt;                // received file counter
+    LaosJobAnalyzer analyzer;   // extent of the upload, computed while receiving
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * StatusServer.cpp
+ * Machine status and telemetry over UDP
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "StatusServer.h"
+#include "LaosMotion.h"
+#include "stepper.h"
+#include "laosjobindex.h"
+
+// create a new status server on port (0: disabled)
+StatusServer::StatusServer(int myport) {
+    port = myport;
+    sock = NULL;
+    jobEnd();
+    if (port == 0)
+        return;
+    printf("StatusServer(): port=%d\n", port);
+    sock = new UDPSocket();
+    if (sock->bind(port)) {
+        delete sock;
+        sock = NULL;
+        return;
+    }
+    sock->set_blocking(false, 0); // never wait: this is polled from the job loop
+}
+
+StatusServer::~StatusServer() {
+    if (sock != NULL) {
+        sock->close();
+        delete sock;
+    }
+}
+
+// a job is started, progress is read from the job reader
+void StatusServer::jobStart(const char *name, LaosReadAhead *in) {
+    strncpy(jobname, name, sizeof(jobname)-1);
+    jobname[sizeof(jobname)-1] = 0;
+    jobin = in;
+    jobsize = in->size();
+    TExtentSummary summary;
+    if (getjobindex(jobname, &summary)) {
+        jobestimate = (int)summary.Time;
+        jobsaved = (int)summary.SavedTime;
+    } else {
+        jobestimate = jobsaved = 0;
+    }
+    jobstart = time(NULL);
+}
+
+// the job has ended
+void StatusServer::jobEnd() {
+    strcpy(jobname, "");
+    jobin = NULL;
+    jobsize = 0;
+    jobestimate = 0;
+    jobsaved = 0;
+    jobstart = 0;
+}
+
+// answer pending status requests
+void StatusServer::poll() {
+    extern LaosMotion *mot;
+    if (sock == NULL)
+        return;
+    Endpoint client;
+    char buff[384];
+    if (sock->receiveFrom(client, buff, sizeof(buff)) <= 0)
+        return;
+
+    int x, y, z;
+    mot->getCurrentPositionRelativeToOrigin(&x, &y, &z);
+    long done = (jobin != NULL ? jobin->tell() : 0);
+    unsigned long hits = (jobin != NULL ? jobin->hits : 0);
+    unsigned long misses = (jobin != NULL ? jobin->misses : 0);
+    int elapsed = 0, remaining = 0;
+    if (jobin != NULL) {
+        elapsed = time(NULL) - jobstart;
+        if (done > 0)
+            remaining = (long long)elapsed * (jobsize - done) / done;
+    }
+    int len = snprintf(buff, sizeof(buff),
+        "job=%s\nbytes=%ld/%ld\nqueue=%d\npos=%d,%d,%d\nload=%d\nelapsed=%d\nremaining=%d\nestimate=%d\nsaved=%d\nreadahead=%lu/%lu\nunderruns=%lu\n",
+        jobname, done, jobsize, mot->queue(), x, y, z, st_get_load(), elapsed, remaining, jobestimate, jobsaved, hits, misses,
+        st_get_underruns());
+    sock->sendTo(client, buff, len);
+}
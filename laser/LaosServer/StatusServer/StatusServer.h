@@ -0,0 +1,78 @@
+/**
+ * StatusServer.h
+ * Machine status and telemetry over UDP
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Any UDP packet sent to the status port is answered with a text report,
+ * one "key=value" per line:
+ *      job=<name of the running job, empty when idle>
+ *      bytes=<bytes consumed>/<file size>
+ *      queue=<nr of blocks in the planner queue>
+ *      pos=<x>,<y>,<z> (position relative to the origin [um])
+ *      load=<step interrupt load over the last second [%]>
+ *      elapsed=<seconds since job start>
+ *      remaining=<estimated seconds until job end>
+ *      estimate=<estimated run time of the job [sec] (0: not analyzed)>
+ *      saved=<run time saved by skipping blank bitmap pixels and joining moves [sec]>
+ *      readahead=<job file buffers read ahead>/<buffers read on demand>
+ *      underruns=<step events a streamed bitmap row waited for its data>
+ * The socket is polled without blocking, so it can be polled from the job loop.
+ *
+ * Example:
+ * @code
+ * StatusServer *statsrv = new StatusServer(cfg->statusport);
+ * ...
+ * statsrv->poll();
+ * @endcode
+ */
+
+#ifndef _STATUSSERVER_H_
+#define _STATUSSERVER_H_
+
+#include <stdio.h>
+#include "mbed.h"
+#include "EthernetInterface.h"
+#include "global.h"
+#include "laosreadahead.h"
+
+class StatusServer {
+
+public:
+    // create a new status server on port (0: disabled)
+    StatusServer(int myport);
+    ~StatusServer();
+    // answer pending status requests
+    void poll();
+    // a job is started, progress is read from the job reader
+    void jobStart(const char *name, LaosReadAhead *in);
+    // the job has ended
+    void jobEnd();
+
+private:
+    int port;               // The UDP port
+    UDPSocket *sock;        // status socket
+    char jobname[32];       // name of the running job
+    LaosReadAhead *jobin;   // reader of the open job file (NULL: no job)
+    long jobsize;           // size of the job file [bytes]
+    int jobestimate;        // estimated run time from the job index [sec]
+    int jobsaved;           // run time saved, from the job index [sec]
+    time_t jobstart;        // RTC time at job start (does not wrap like systime)
+};
+
+#endif
@@ -22,6 +22,12 @@
  */
 #include "TFTPServer.h"
 
+// return the nr of milliseconds elapsed since "since" (a systime value in [usec])
+static unsigned int elapsed_ms(unsigned int since) {
+    extern Timer systime;
+    return ((unsigned int)systime.read_us() - since) / 1000;
+}
+
 // create a new tftp server, with file directory dir and
 // listening on port
 
@@ -39,6 +45,11 @@ TFTPServer::TFTPServer(int myport) {
     ListenSock->set_blocking(false, 1);
     SendSock->set_blocking(false, 1);
     filecnt = 0;
+    fp = NULL;
+    oacklen = 0;
+    reserved = -1;
+    strcpy(remote_ip, "");
+    restartTimer();
 }
 
 // destroy this instance of the tftp server
@@ -95,8 +106,12 @@ int TFTPServer::fileCnt() {
 // create a new connection reading a file from server
 void TFTPServer::ConnectRead(char* buff) {
     extern LaosFileSystem sd;
-    remote_ip = client.get_address();
+    strncpy(remote_ip, client.get_address(), sizeof(remote_ip)-1);
+    remote_ip[sizeof(remote_ip)-1] = 0;
     remote_port = client.get_port();
+    remote = client;
+    restartTimer();
+    oacklen = 0;
     Ack(0);
     blockcnt = 0;
     dupcnt = 0;
@@ -126,26 +141,49 @@ void TFTPServer::ConnectRead(char* buff) {
 }
 
 // create a new connection writing a file to the server
-void TFTPServer::ConnectWrite(char* buff) {
+void TFTPServer::ConnectWrite(char* buff, int len) {
     extern LaosFileSystem sd;
     // printf("ConnectWrite()\n");
-    remote_ip = client.get_address();
+    strncpy(remote_ip, client.get_address(), sizeof(remote_ip)-1);
+    remote_ip[sizeof(remote_ip)-1] = 0;
     remote_port = client.get_port();
-    Ack(0);
+    remote = client;
+    restartTimer();
     blockcnt = 0;
     dupcnt = 0;
     connect_cnt++;
+    received = 0;
+    reserved = -1;
+    oacklen = 0;
 
     sprintf(filename, "%s", &buff[2]);
     sd.shorten(filename, MAXFILESIZE);
     // printf("filename: %s\n", filename);
     
-    if (modeOctet(buff))
+    int octet = modeOctet(buff);
+    long tsize = getOption(buff, len, "tsize");
+    if (tsize >= 0) {
+        // acknowledge the size; a file that can not be allocated is
+        // written the normal way
+        oack[0] = 0x00;
+        oack[1] = 0x06;
+        oacklen = 2 + sprintf(&oack[2], "tsize%c%ld", 0, tsize) + 1;
+        if (octet && (tsize > 0) && (sd.reserve(filename, tsize) == 0))
+            reserved = tsize;
+    }
+    analyzer.start(filename);
+    if (reserved >= 0)
+        fp = sd.openfile(filename, "r+b");
+    else if (octet)
         fp = sd.openfile(filename, "wb");
     else
         fp = sd.openfile(filename, "w");
+    Ack(0);
     if (fp == NULL) {
         Err("Could not open file to write");
+        if (reserved >= 0) // do not leave the allocated file behind
+            removefile(filename);
+        reserved = -1;
         state  = listen;
         strcpy(remote_ip,"");
     } else {
@@ -195,6 +233,10 @@ int TFTPServer::cmpHost() {
 void TFTPServer::Ack(int val) {
     char ack[4];
    // printf("Ack(%d)\n", val);
+    if ((val == 0) && (oacklen > 0)) { // options are acknowledged by an OACK
+        SendSock->sendTo(client, oack, oacklen);
+        return;
+    }
     ack[0] = 0x00;
     ack[1] = 0x04;
     if ((val>603135) || (val<0)) val = 0;
@@ -231,6 +273,25 @@ void TFTPServer::Err(const std::string& msg) {
 	strcpy(remote_ip,"");
 }
 
+// value of an option in a request, -1 if the client did not send it
+// The options follow the mode field as "name\0value\0" pairs
+long TFTPServer::getOption(char* buff, int len, const char* name) {
+    int x = 2;
+    while ((x < len) && (buff[x++] != 0)); // skip file name
+    while ((x < len) && (buff[x++] != 0)); // skip mode
+    while (x < len) {
+        char *opt = &buff[x];
+        while ((x < len) && (buff[x++] != 0));
+        char *val = &buff[x];
+        while ((x < len) && (buff[x++] != 0));
+        if ((buff[x-1] != 0) || (val >= &buff[x]))
+            break;  // not terminated
+        if (strcasecmp(opt, name) == 0)
+            return atol(val);
+    }
+    return -1;
+}
+
 // check if connection mode of client is octet/binary
 int TFTPServer::modeOctet(char* buff) {
     int x = 2;
@@ -247,6 +308,7 @@ int TFTPServer::modeOctet(char* buff) {
 // A bit naive: only support one client. The 1st packet will be received on TFTP port (69) then we will reply by sending packets on the WriteSocket(2048) and all
 // subsequent packets will be received on that port also
 void TFTPServer::poll() {
+    extern LaosFileSystem sd;
     if ((state == suspended) || (state == deleted) || (state == tftperror)) {
         return;
     }
@@ -256,6 +318,7 @@ void TFTPServer::poll() {
 		len = SendSock->receiveFrom(client, buff, sizeof(buff));
     }
     if (len == 0) {
+        cleanUp();
 		return;
     }
 
@@ -272,7 +335,7 @@ void TFTPServer::poll() {
                     ConnectRead(buff);
                     break;
                 case 0x02: // WRQ
-                    ConnectWrite(buff);
+                    ConnectWrite(buff, len);
                     break;
                 case 0x03: // DATA before connection established
                     Err("No data expected");
@@ -315,11 +378,13 @@ void TFTPServer::poll() {
 	                case 0x04:
 	                    // last packet received, send next if there is one
 	                    dupcnt = 0;
+	                    restartTimer();
 	                    if (len == 516) {
 	                        getBlock();
 	                        sendBlock();
 	                    } else { //EOF
 	                        fclose(fp);
+	                        fp = NULL;
 	                        state = listen;
                             strcpy(remote_ip,"");
 	                    }
@@ -346,20 +411,25 @@ void TFTPServer::poll() {
 	                case 0x03: {
 	                    int block = (buff[2] << 8) + buff[3];
 	                    if ((blockcnt+1) == block) {
+	                        restartTimer();
 	                        Ack(block);
 	                        // new packet
 	                        char *data = &buff[4];
 	                        fwrite(data, 1,len-4, fp);
+	                        analyzer.write(data, len-4);
+	                        received += len-4;
 	                        blockcnt++;
 	                        dupcnt = 0;
 	                    } else { // mismatch in block nr
 	                        if ((blockcnt+1) < block) { // too high
                                 Err("Packet count mismatch");
-	                            remove(filename);
+	                            removefile(filename);
+	                            break; // transfer aborted, the file is gone
 	                         } else { // duplicate packet, send ACK again
 	                            if (dupcnt > 10) {
 	                                Err("Too many dups");
-	                                remove(filename);
+	                                removefile(filename);
+	                                break; // transfer aborted, the file is gone
 	                            } else {
 	                                Ack(blockcnt);
                                     dupcnt++;
@@ -369,9 +439,18 @@ void TFTPServer::poll() {
                         if (len<516) {
                             Ack(blockcnt);
                             fclose(fp);
+                            fp = NULL;
+                            if ((reserved >= 0) && (received != reserved)) // tsize was wrong
+                                sd.truncate(filename, received);
+                            reserved = -1;
                             strcpy(remote_ip,"");
                             state = listen;
                             filecnt++;
+                            if (optimizejob(filename))
+                                indexjob(filename); // the paths were reordered: analyze again
+                            else
+                                analyzer.finish(filename);
+                            sd.addjob(filename);
                             printf("File receive finished\n");
                         }
 	                    break; // case 0x03
@@ -394,3 +473,42 @@ void TFTPServer::poll() {
         }
     } // state
 }
+
+// restart the retransmit timer after a valid packet of the peer
+void TFTPServer::restartTimer() {
+    extern Timer systime;
+    last_activity = systime.read_us();
+    timeout = TFTP_TIMEOUT;
+    retries = 0;
+}
+
+// timed routine to avoid hanging after interrupted transfers
+// Called when no packet is waiting: if the peer did not answer within the
+// timeout, resend our last packet (DATA while reading, ACK while writing)
+// and double the timeout. After TFTP_MAX_RETRIES the session is aborted,
+// and a partially written file is removed.
+void TFTPServer::cleanUp() {
+    extern Timer systime;
+    if ((state != reading) && (state != writing))
+        return;
+    if (elapsed_ms(last_activity) < timeout)
+        return;
+    client = remote; // answer the connected peer, not the last sender
+    if (retries >= TFTP_MAX_RETRIES) {
+        printf("TFTP: transfer of %s timed out\n", filename);
+        TFTPServerState oldstate = state;
+        Err("Transfer timed out");
+        if (oldstate == writing)
+            removefile(filename);
+        return;
+    }
+    retries++;
+    timeout *= 2;
+    if (timeout > TFTP_MAX_TIMEOUT)
+        timeout = TFTP_MAX_TIMEOUT;
+    last_activity = systime.read_us();
+    if (state == reading)
+        sendBlock();
+    else
+        Ack(blockcnt);
+}
@@ -24,8 +24,12 @@
  *      * Server handles only one transfer at a time
  *      * Supports only binary mode transfers, no (net)ascii
  *      * fixed block size: 512 bytes
+ *      * tsize option on upload: the file is allocated in one go before the
+ *        data arrives (contiguous when the free space is), and the option is
+ *        acknowledged with an OACK
  *
  * http://spectral.mscs.mu.edu/RFC/rfc1350.html
+ * http://spectral.mscs.mu.edu/RFC/rfc2349.html
  *
  * Example:
  * @code 
@@ -44,10 +48,15 @@
 #include <ctype.h>
 #include "mbed.h"
 #include "laosfilesystem.h"
+#include "laosjobindex.h"
+#include "laosoptimize.h"
 #include "EthernetInterface.h"
 #include "global.h"
 
 #define TFTP_PORT 69
+#define TFTP_TIMEOUT 1000       // initial retransmit timeout [msec]
+#define TFTP_MAX_TIMEOUT 8000   // upper limit of the (doubling) retransmit timeout [msec]
+#define TFTP_MAX_RETRIES 5      // retransmits without an answer before a transfer is aborted
 //#define TFTP_DEBUG(x) printf("%s\n\r", x);
 
 enum TFTPServerState { listen, reading, writing, tftperror, suspended, deleted }; 
@@ -79,7 +88,7 @@ private:
     // create a new connection reading a file from server
     void ConnectRead(char* buff);
     // create a new connection writing a file to the server
-    void ConnectWrite(char* buff);
+    void ConnectWrite(char* buff, int len);
     // get DATA block from file on disk into memory
     void getBlock();
     // send DATA block to the client
@@ -95,22 +104,34 @@ private:
     void Err(const std::string& msg);
     // check if connection mode of client is octet/binary
     int modeOctet(char* buff);
+    // value of an option in a request, -1 if the client did not send it
+    long getOption(char* buff, int len, const char* name);
     // timed routine to avoid hanging after interrupted transfers
     void cleanUp();
+    // restart the retransmit timer after a valid packet of the peer
+    void restartTimer();
     // event driven routines to handle incoming packets
     // void onListenUDPSocketEvent(UDPSocketEvent e);
     int port; // The TFTP port
     UDPSocket* ListenSock;      // main listening socket (dflt: UDP port 69)
     UDPSocket* SendSock;		// local socket to send UDP packets
     TFTPServerState state;      // current TFTP server state
-    char* remote_ip;         // connected remote Host IP
+    char remote_ip[17];         // connected remote Host IP
     int remote_port;            // connected remote Host Port
+    Endpoint remote;            // connected remote Host (retransmits go here)
     int blockcnt, dupcnt;       // block counter, and DUP counter
     FILE* fp;                   // current file to read or write
     char sendbuff[516];         // current DATA block;
     int blocksize;              // last DATA block size while sending
+    char oack[24];              // OACK packet, sent instead of ACK 0
+    int oacklen;                // size of the OACK packet (0: no options)
+    long reserved;              // bytes allocated for the upload (-1: none)
+    long received;              // bytes written to the upload
+    LaosJobAnalyzer analyzer;   // extent of the upload, computed while receiving
     char filename[256];         // current (or most recent) filename
-    //Ticker TFTPServerTimer;     // timeout timer
+    unsigned int last_activity; // systime [usec] of the last packet of the peer (or retransmit)
+    unsigned int timeout;       // current retransmit timeout [msec]
+    int retries;                // retransmits since the last packet of the peer
     int filecnt;                // received file counter
     int connect_cnt;			// Connection counter
     Endpoint client;
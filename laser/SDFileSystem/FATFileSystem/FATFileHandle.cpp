@@ -27,6 +27,20 @@
 
 FATFileHandle::FATFileHandle(FIL fh) {
     _fh = fh;
+#if _USE_FASTSEEK
+    // A file that is only read gets a cluster link map: seeks and cluster
+    // changes are looked up in the map instead of following the FAT chain.
+    // (Fast seek mode can not stretch a file, so not for files written to)
+    if (!(_fh.flag & FA_WRITE)) {
+        _cltbl[0] = FAT_CLMT_ITEMS;
+        _fh.cltbl = _cltbl;
+        FRESULT res = f_lseek(&_fh, CREATE_LINKMAP);
+        if (res) {
+            debug_if(FFS_DBG, "link map failed: %d (%d items needed)\n", res, _cltbl[0]);
+            _fh.cltbl = 0;
+        }
+    }
+#endif
 }
 
 int FATFileHandle::close() {
@@ -23,6 +23,11 @@
 #define MBED_FATFILEHANDLE_H
 
 #include "FileHandle.h"
+#include "ff.h"
+
+/* Size of the cluster link map of a file opened for reading (2 items per
+ * fragment + 3). A file with more fragments uses normal seeks. */
+#define FAT_CLMT_ITEMS 32
 
 using namespace mbed;
 
@@ -41,6 +46,7 @@ public:
 protected:
 
     FIL _fh;
+    DWORD _cltbl[FAT_CLMT_ITEMS];   // cluster link map for fast seek
 
 };
 
@@ -108,6 +108,76 @@ int FATFileSystem::remove(const char *filename) {
     return 0;
 }
 
+// Multiple sector transfers, drivers that can do better override these
+int FATFileSystem::disk_read(uint8_t *buffer, uint64_t sector, int count) {
+    for (int s = 0; s < count; s++) {
+        if (disk_read(buffer, sector + s))
+            return 1;
+        buffer += 512;
+    }
+    return 0;
+}
+
+int FATFileSystem::disk_write(const uint8_t *buffer, uint64_t sector, int count) {
+    for (int s = 0; s < count; s++) {
+        if (disk_write(buffer, sector + s))
+            return 1;
+        buffer += 512;
+    }
+    return 0;
+}
+
+int FATFileSystem::rename(const char *oldname, const char *newname) {
+    FRESULT res = f_rename(oldname, newname);
+    if (res) {
+        debug_if(FFS_DBG, "f_rename() failed: %d\n", res);
+        return -1;
+    }
+    return 0;
+}
+
+// Create an empty file of size bytes: the cluster chain is allocated in
+// one go, so it is contiguous when the free space is. Open it "r+" to fill.
+int FATFileSystem::reserve(const char *name, uint32_t size) {
+    FIL fh;
+    FRESULT res = f_open(&fh, name, FA_WRITE|FA_CREATE_ALWAYS);
+    if (res) {
+        debug_if(FFS_DBG, "f_open() failed: %d\n", res);
+        return -1;
+    }
+    res = f_lseek(&fh, size);   // in write mode, this stretches the chain
+    if (!res && (fh.fsize != size)) 
+        res = FR_DENIED;        // disk full
+    if (res) {
+        debug_if(FFS_DBG, "reserve(%s, %lu) failed: %d\n", name, size, res);
+        f_lseek(&fh, 0);
+        f_truncate(&fh);
+        f_close(&fh);
+        return -1;
+    }
+    res = f_close(&fh);
+    return (res ? -1 : 0);
+}
+
+// Cut a file at size bytes
+int FATFileSystem::truncate(const char *name, uint32_t size) {
+    FIL fh;
+    FRESULT res = f_open(&fh, name, FA_WRITE);
+    if (!res) {
+        res = f_lseek(&fh, size);
+        if (!res) 
+            res = f_truncate(&fh);
+        FRESULT cres = f_close(&fh);
+        if (!res)
+            res = cres;
+    }
+    if (res) {
+        debug_if(FFS_DBG, "truncate(%s, %lu) failed: %d\n", name, size, res);
+        return -1;
+    }
+    return 0;
+}
+
 int FATFileSystem::format() {
     FRESULT res = f_mkfs(_fsid, 0, 512); // Logical drive number, Partitioning rule, Allocation unit size (bytes per cluster)
     if (res) {
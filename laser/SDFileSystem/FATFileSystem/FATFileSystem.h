@@ -41,6 +41,9 @@ public:
 
     virtual FileHandle *open(const char* name, int flags);
     virtual int remove(const char *filename);
+    virtual int rename(const char *oldname, const char *newname);
+    virtual int reserve(const char *name, uint32_t size);
+    virtual int truncate(const char *name, uint32_t size);
     virtual int format();
     virtual DirHandle *opendir(const char *name);
     virtual int mkdir(const char *name, mode_t mode);
@@ -49,6 +52,8 @@ public:
     virtual int disk_status() { return 0; }
     virtual int disk_read(uint8_t * buffer, uint64_t sector) = 0;
     virtual int disk_write(const uint8_t * buffer, uint64_t sector) = 0;
+    virtual int disk_read(uint8_t * buffer, uint64_t sector, int count);
+    virtual int disk_write(const uint8_t * buffer, uint64_t sector, int count);
     virtual int disk_sync() { return 0; }
     virtual uint64_t disk_sectors() = 0;
 
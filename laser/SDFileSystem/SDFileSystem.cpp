@@ -60,10 +60,11 @@
  * just always use the Standard Capacity cards with a block size of 512 bytes.
  * This is set with CMD16.
  *
- * You can read and write single blocks (CMD17, CMD25) or multiple blocks
- * (CMD18, CMD25). For simplicity, I'll just use single block accesses. When
- * the card gets a read command, it responds with a response token, and then
- * a data token or an error.
+ * You can read and write single blocks (CMD17, CMD24) or multiple blocks
+ * (CMD18, CMD25). Single sectors use the single block commands, runs of
+ * sectors that FatFs hands over in one go use the multiple block commands.
+ * When the card gets a read command, it responds with a response token, and
+ * then a data token or an error.
  *
  * SPI Command Format
  * ------------------
@@ -73,7 +74,9 @@
  * | 01 | cmd[5:0] | arg[31:24] | arg[23:16] | arg[15:8] | arg[7:0] | crc[6:0] | 1 |
  * +---------------+------------+------------+-----------+----------+--------------+
  *
- * As I'm not using CRC, I can fix that byte to what is needed for CMD0 (0x95)
+ * The CRC7 is calculated for every command. After initialisation CRC checking
+ * is switched on (CMD59), so the card rejects commands and data blocks that
+ * were garbled on the bus; the driver then retries at a lower clock.
  *
  * All Application Specific commands shall be preceded with APP_CMD (CMD55).
  *
@@ -111,17 +114,64 @@
  * +------+---------+---------+- -  - -+---------+-----------+----------+
  * | 0xFE | data[0] | data[1] |        | data[n] | crc[15:8] | crc[7:0] |
  * +------+---------+---------+- -  - -+---------+-----------+----------+
+ *
+ * Multiple Block Read and Write
+ * -----------------------------
+ *
+ * After CMD18 the card sends data blocks (each with a 0xFE token) until
+ * it receives CMD12 (STOP_TRANSMISSION). The byte following CMD12 is a
+ * stuff byte, then the R1b response follows.
+ *
+ * After CMD25 every block is sent with a 0xFC token and acknowledged
+ * with a data response token, after which the card is busy until the
+ * block is programmed. The 0xFD token ends the transfer.
  */
 #include "SDFileSystem.h"
 #include "mbed_debug.h"
 
 #define SD_COMMAND_TIMEOUT 5000
+#define SD_DATA_TIMEOUT    500     // ms to wait for a data token or busy
+#define SD_MIN_FREQUENCY   1000000 // don't slow down below this after errors
 
 #define SD_DBG             0
 
 SDFileSystem::SDFileSystem(PinName mosi, PinName miso, PinName sclk, PinName cs, const char* name) :
     FATFileSystem(name), _spi(mosi, miso, sclk), _cs(cs) {
     _cs = 1;
+    _freq = 0;
+    _max_freq = SD_MIN_FREQUENCY;
+    _tran_speed = SD_MIN_FREQUENCY;
+}
+
+// CRC7 of a command frame, including the end bit
+static uint8_t crc7(const uint8_t *data, int length) {
+    uint8_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        uint8_t d = data[i];
+        for (int b = 0; b < 8; b++) {
+            crc <<= 1;
+            if ((d ^ crc) & 0x80) {
+                crc ^= 0x09;
+            }
+            d <<= 1;
+        }
+    }
+    return (crc << 1) | 1;
+}
+
+// CRC16 (CCITT) of a data block, a nibble at a time
+static const uint16_t crc16_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static uint16_t crc16(const uint8_t *data, int length) {
+    uint16_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
 }
 
 #define R1_IDLE_STATE           (1 << 0)
@@ -210,30 +260,144 @@ int SDFileSystem::disk_initialize() {
         return 1;
     }
     
-    _spi.frequency(1000000); // Set to 1MHz for data transfer
+    // Switch on CRC checking (CMD59), cards that refuse just go without
+    if (_cmd(59, 1) != 0) {
+        debug("Could not enable CRC checking\n");
+    }
+    
+    // Data transfer clock: what the card allows (CSD), up to the ceiling
+    _freq = (_tran_speed < _max_freq) ? _tran_speed : _max_freq;
+    _spi.frequency(_freq);
+    debug_if(SD_DBG, "SD clock %d Hz\n", _freq);
+    return 0;
+}
+
+void SDFileSystem::set_max_frequency(int hz) {
+    _max_freq = (hz > SD_MIN_FREQUENCY) ? hz : SD_MIN_FREQUENCY;
+    if (_freq) {    // already initialised
+        _freq = (_tran_speed < _max_freq) ? _tran_speed : _max_freq;
+        _spi.frequency(_freq);
+    }
+}
+
+int SDFileSystem::frequency() {
+    return _freq;
+}
+
+// Lower the clock after a transfer error, fails when already at the minimum
+int SDFileSystem::_slow_down() {
+    if (_freq <= SD_MIN_FREQUENCY) {
+        return 1;
+    }
+    _freq /= 2;
+    if (_freq < SD_MIN_FREQUENCY) {
+        _freq = SD_MIN_FREQUENCY;
+    }
+    debug("SD transfer error, clock lowered to %d Hz\n", _freq);
+    _spi.frequency(_freq);
     return 0;
 }
 
 int SDFileSystem::disk_write(const uint8_t *buffer, uint64_t block_number) {
+    return disk_write(buffer, block_number, 1);
+}
+
+int SDFileSystem::disk_read(uint8_t *buffer, uint64_t block_number) {
+    return disk_read(buffer, block_number, 1);
+}
+
+int SDFileSystem::disk_write(const uint8_t *buffer, uint64_t block_number, int count) {
+    // retry at a lower clock after a CRC or response error
+    while (_write_blocks(buffer, block_number, count) != 0) {
+        if (_slow_down() != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int SDFileSystem::disk_read(uint8_t *buffer, uint64_t block_number, int count) {
+    while (_read_blocks(buffer, block_number, count) != 0) {
+        if (_slow_down() != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int SDFileSystem::_write_single(const uint8_t *buffer, uint64_t block_number) {
     // set write address for single block (CMD24)
     if (_cmd(24, block_number * cdv) != 0) {
         return 1;
     }
     
     // send the data block
-    _write(buffer, 512);
-    return 0;
+    return _write(buffer, 512);
 }
 
-int SDFileSystem::disk_read(uint8_t *buffer, uint64_t block_number) {
+int SDFileSystem::_read_single(uint8_t *buffer, uint64_t block_number) {
     // set read address for single block (CMD17)
     if (_cmd(17, block_number * cdv) != 0) {
         return 1;
     }
     
     // receive the data
-    _read(buffer, 512);
-    return 0;
+    return _read(buffer, 512);
+}
+
+int SDFileSystem::_write_blocks(const uint8_t *buffer, uint64_t block_number, int count) {
+    if (count == 1) {
+        return _write_single(buffer, block_number);
+    }
+    
+    // set write address for multiple blocks (CMD25)
+    if (_cmd(25, block_number * cdv) != 0) {
+        return 1;
+    }
+    
+    // send the data blocks, stop at the first error
+    _cs = 0;
+    int res = 0;
+    for (int b = 0; (b < count) && (res == 0); b++) {
+        res = _write_block(0xFC, buffer, 512);
+        buffer += 512;
+    }
+    
+    // stop transmission token, then wait for the last block to finish
+    _spi.write(0xFD);
+    _spi.write(0xFF);
+    if (_wait_ready() != 0) {
+        res = 1;
+    }
+    _cs = 1;
+    _spi.write(0xFF);
+    return res;
+}
+
+int SDFileSystem::_read_blocks(uint8_t *buffer, uint64_t block_number, int count) {
+    if (count == 1) {
+        return _read_single(buffer, block_number);
+    }
+    
+    // set read address for multiple blocks (CMD18), cs stays low
+    if (_cmdx(18, block_number * cdv) != 0) {
+        _cs = 1;
+        _spi.write(0xFF);
+        return 1;
+    }
+    
+    // receive the data blocks
+    int res = 0;
+    for (int b = 0; (b < count) && (res == 0); b++) {
+        res = _read_block(buffer, 512);
+        buffer += 512;
+    }
+    
+    // stop transmission (CMD12)
+    if (_cmd12() != 0) {
+        res = 1;
+    }
+    return res;
 }
 
 int SDFileSystem::disk_status() { return 0; }
@@ -242,16 +406,25 @@ uint64_t SDFileSystem::disk_sectors() { return _sectors; }
 
 
 // PRIVATE FUNCTIONS
+// send a command frame with its CRC7, cs must be low
+void SDFileSystem::_send_cmd(int cmd, int arg) {
+    uint8_t frame[5];
+    frame[0] = 0x40 | cmd;
+    frame[1] = arg >> 24;
+    frame[2] = arg >> 16;
+    frame[3] = arg >> 8;
+    frame[4] = arg >> 0;
+    for (int i = 0; i < 5; i++) {
+        _spi.write(frame[i]);
+    }
+    _spi.write(crc7(frame, 5));
+}
+
 int SDFileSystem::_cmd(int cmd, int arg) {
     _cs = 0;
     
     // send a command
-    _spi.write(0x40 | cmd);
-    _spi.write(arg >> 24);
-    _spi.write(arg >> 16);
-    _spi.write(arg >> 8);
-    _spi.write(arg >> 0);
-    _spi.write(0x95);
+    _send_cmd(cmd, arg);
     
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
@@ -270,12 +443,7 @@ int SDFileSystem::_cmdx(int cmd, int arg) {
     _cs = 0;
     
     // send a command
-    _spi.write(0x40 | cmd);
-    _spi.write(arg >> 24);
-    _spi.write(arg >> 16);
-    _spi.write(arg >> 8);
-    _spi.write(arg >> 0);
-    _spi.write(0x95);
+    _send_cmd(cmd, arg);
     
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
@@ -295,12 +463,7 @@ int SDFileSystem::_cmd58() {
     int arg = 0;
     
     // send a command
-    _spi.write(0x40 | 58);
-    _spi.write(arg >> 24);
-    _spi.write(arg >> 16);
-    _spi.write(arg >> 8);
-    _spi.write(arg >> 0);
-    _spi.write(0x95);
+    _send_cmd(58, arg);
     
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
@@ -337,7 +500,7 @@ int SDFileSystem::_cmd8() {
         response[0] = _spi.write(0xFF);
         if (!(response[0] & 0x80)) {
             for (int j = 1; j < 5; j++) {
-                response[i] = _spi.write(0xFF);
+                response[j] = _spi.write(0xFF);
             }
             _cs = 1;
             _spi.write(0xFF);
@@ -349,29 +512,75 @@ int SDFileSystem::_cmd8() {
     return -1; // timeout
 }
 
-int SDFileSystem::_read(uint8_t *buffer, uint32_t length) {
-    _cs = 0;
+// stop a multiple block read, cs is still low
+int SDFileSystem::_cmd12() {
+    _send_cmd(12, 0);
+    _spi.write(0xFF);     // stuff byte
     
-    // read until start byte (0xFF)
-    while (_spi.write(0xFF) != 0xFE);
-    
-    // read data
-    for (int i = 0; i < length; i++) {
-        buffer[i] = _spi.write(0xFF);
+    // wait for the repsonse (response[7] == 0), then while busy
+    for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
+        int response = _spi.write(0xFF);
+        if (!(response & 0x80)) {
+            if (_wait_ready() != 0) {
+                response = -1;
+            }
+            _cs = 1;
+            _spi.write(0xFF);
+            return response;
+        }
     }
-    _spi.write(0xFF); // checksum
+    _cs = 1;
     _spi.write(0xFF);
-    
+    return -1; // timeout
+}
+
+int SDFileSystem::_read(uint8_t *buffer, uint32_t length) {
+    _cs = 0;
+    int res = _read_block(buffer, length);
     _cs = 1;
     _spi.write(0xFF);
-    return 0;
+    return res;
 }
 
 int SDFileSystem::_write(const uint8_t*buffer, uint32_t length) {
     _cs = 0;
+    int res = _write_block(0xFE, buffer, length);
+    _cs = 1;
+    _spi.write(0xFF);
+    return res;
+}
+
+// receive one data block, cs must be low
+int SDFileSystem::_read_block(uint8_t *buffer, uint32_t length) {
+    // read until start byte (0xFE), anything else but 0xFF is an error token
+    int token = 0xFF;
+    Timer t;
+    t.start();
+    while ((token == 0xFF) && (t.read_ms() < SD_DATA_TIMEOUT)) {
+        token = _spi.write(0xFF);
+    }
+    if (token != 0xFE) {
+        debug_if(SD_DBG, "Read error token 0x%02X\n", token);
+        return 1;
+    }
     
+    // read data
+    for (int i = 0; i < length; i++) {
+        buffer[i] = _spi.write(0xFF);
+    }
+    uint16_t crc = _spi.write(0xFF) << 8; // checksum
+    crc |= _spi.write(0xFF);
+    if (crc != crc16(buffer, length)) {
+        debug_if(SD_DBG, "Read CRC error\n");
+        return 1;
+    }
+    return 0;
+}
+
+// send one data block with the given start token, cs must be low
+int SDFileSystem::_write_block(int token, const uint8_t*buffer, uint32_t length) {
     // indicate start of block
-    _spi.write(0xFE);
+    _spi.write(token);
     
     // write the data
     for (int i = 0; i < length; i++) {
@@ -379,22 +588,29 @@ int SDFileSystem::_write(const uint8_t*buffer, uint32_t length) {
     }
     
     // write the checksum
-    _spi.write(0xFF);
-    _spi.write(0xFF);
+    uint16_t crc = crc16(buffer, length);
+    _spi.write(crc >> 8);
+    _spi.write(crc & 0xFF);
     
-    // check the response token
+    // check the response token (0x0B: CRC error, 0x0D: write error)
     if ((_spi.write(0xFF) & 0x1F) != 0x05) {
-        _cs = 1;
-        _spi.write(0xFF);
         return 1;
     }
     
     // wait for write to finish
-    while (_spi.write(0xFF) == 0);
-    
-    _cs = 1;
-    _spi.write(0xFF);
-    return 0;
+    return _wait_ready();
+}
+
+// wait while the card signals busy (zeros)
+int SDFileSystem::_wait_ready() {
+    Timer t;
+    t.start();
+    while (t.read_ms() < SD_DATA_TIMEOUT) {
+        if (_spi.write(0xFF) != 0) {
+            return 0;
+        }
+    }
+    return 1; // timeout
 }
 
 static uint32_t ext_bits(unsigned char *data, int msb, int lsb) {
@@ -429,12 +645,24 @@ uint64_t SDFileSystem::_sd_sectors() {
     }
     
     // csd_structure : csd[127:126]
+    // tran_speed    : csd[103:96] - max data transfer rate
     // c_size        : csd[73:62]
     // c_size_mult   : csd[49:47]
     // read_bl_len   : csd[83:80] - the *maximum* read block length
     
     int csd_structure = ext_bits(csd, 127, 126);
     
+    // tran_speed is a rate unit (100kbit/s..100Mbit/s) times a value (1.0..8.0)
+    static const int tran_unit[4] = { 10000, 100000, 1000000, 10000000 };
+    static const int tran_value[16] = { 0, 10, 12, 13, 15, 20, 25, 30,
+                                        35, 40, 45, 50, 55, 60, 70, 80 };
+    int tran_speed = ext_bits(csd, 103, 96);
+    _tran_speed = tran_unit[(tran_speed & 7) > 3 ? 3 : (tran_speed & 7)] * tran_value[(tran_speed >> 3) & 15];
+    if (_tran_speed < SD_MIN_FREQUENCY) {
+        _tran_speed = SD_MIN_FREQUENCY;
+    }
+    debug_if(SD_DBG, "\n\rtran_speed: 0x%02X (%d Hz)\n\r", tran_speed, _tran_speed);
+    
     switch (csd_structure) {
         case 0:
             cdv = 512;
@@ -56,14 +56,30 @@ public:
     virtual int disk_status();
     virtual int disk_read(uint8_t * buffer, uint64_t block_number);
     virtual int disk_write(const uint8_t * buffer, uint64_t block_number);
+    virtual int disk_read(uint8_t * buffer, uint64_t block_number, int count);
+    virtual int disk_write(const uint8_t * buffer, uint64_t block_number, int count);
     virtual int disk_sync();
     virtual uint64_t disk_sectors();
+    
+    /** Limit the data transfer clock
+     *
+     * The clock is the speed the card reports in its CSD, but no more
+     * than this ceiling. After CRC or response errors it is lowered.
+     *
+     * @param hz Maximum SPI clock in Hz
+     */
+    void set_max_frequency(int hz);
+    
+    /** Current data transfer clock in Hz */
+    int frequency();
 
 protected:
 
+    void _send_cmd(int cmd, int arg);
     int _cmd(int cmd, int arg);
     int _cmdx(int cmd, int arg);
     int _cmd8();
+    int _cmd12();
     int _cmd58();
     int initialise_card();
     int initialise_card_v1();
@@ -71,12 +87,23 @@ protected:
     
     int _read(uint8_t * buffer, uint32_t length);
     int _write(const uint8_t *buffer, uint32_t length);
+    int _read_block(uint8_t * buffer, uint32_t length);
+    int _write_block(int token, const uint8_t *buffer, uint32_t length);
+    int _wait_ready();
+    int _read_single(uint8_t * buffer, uint64_t block_number);
+    int _write_single(const uint8_t * buffer, uint64_t block_number);
+    int _read_blocks(uint8_t * buffer, uint64_t block_number, int count);
+    int _write_blocks(const uint8_t * buffer, uint64_t block_number, int count);
+    int _slow_down();
     uint64_t _sd_sectors();
     uint64_t _sectors;
     
     SPI _spi;
     DigitalOut _cs;
     int cdv;
+    int _freq;          // current data transfer clock
+    int _max_freq;      // configured ceiling
+    int _tran_speed;    // maximum clock from the CSD
 };
 
 #endif
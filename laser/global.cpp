@@ -69,14 +69,18 @@ GlobalConfig::GlobalConfig(const std::string& filename)
     cfg.Value("net.dns", dns, sizeof(dns), "192.168.0.1");
     cfg.Value("net.port", &port, 69);
     cfg.Value("net.dhcp", &dhcp, 0);
+    cfg.Value("net.jobport", &jobport, 0);
+    cfg.Value("net.statusport", &statusport, 0);
 
     // features
     cfg.Value("sys.autohome", &autohome, 0);
     cfg.Value("sys.autozhome", &autozhome, 0);
     cfg.Value("sys.nodisplay", &nodisplay, 1);
     cfg.Value("sys.i2cbaud", &i2cbaud, 9600);
+    cfg.Value("sys.sdspeed", &sdspeed, 25000);
     cfg.Value("sys.cleandir", &cleandir, 1);
     cfg.Value("sys.disablecancelcheck", &disablecancelcheck, 0);
+    cfg.Value("sys.optimize", &optimize, 0);
     
     // Laser
     cfg.Value("laser.enable", &lenable, 1); // laser enable polarity [0/1]
@@ -84,6 +88,10 @@ GlobalConfig::GlobalConfig(const std::string& filename)
     cfg.Value("laser.pwm.min", &pwmmin, 0); // pwm at minimum power [0..100]
     cfg.Value("laser.pwm.max", &pwmmax, 0); // pwm at maximum power [0..100]
     cfg.Value("laser.pwm.freq", &pwmfreq, 20000); // pwm frequency [Hz]
+    cfg.Value("laser.shift.pos", &lshiftpos, 0); // bitmap shift for the laser delay in +x direction [um]
+    cfg.Value("laser.shift.neg", &lshiftneg, 0); // bitmap shift for the laser delay in -x direction [um]
+    cfg.Value("laser.ppi", &lppi, 0);       // laser pulses per inch on lines (0: continuous)
+    cfg.Value("laser.pulse", &lpulse, 1000); // length of a laser pulse [usec]
     cfg.Value("sys.exhaustoffdelay", &exhaust_offdelay, 30); 
 	// how long to continue air assist/extract after job completion (secs)
     
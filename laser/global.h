@@ -40,13 +40,17 @@ public:
 
   IPAddress ip, gw, nm, dns;
   int port, dhcp;  // network settings
+  int jobport; // TCP job server port (0: disabled)
+  int statusport; // UDP status port (0: disabled)
   int enable; // enable state (1 or 0)
   int autohome; // automatically home the axis at startup
   int autozhome; // automatically home the zaxis as well
   int nodisplay; // there is no display 
   int cleandir; // remove files from SD at startup
   int i2cbaud; // i2cBaudrate
+  int sdspeed; // maximum SD card clock [kHz]
   int disablecancelcheck; // if the check for cancel button should be disabled while a job is running
+  int optimize; // reorder the paths of uploaded jobs to shorten the moves
   int xmax, ymax, zmax, emax; // max values
   int xmin, ymin, zmin, emin; // min values
   int xpol, ypol, zpol, epol; // polarity for the home switches
@@ -64,6 +68,8 @@ public:
   int zscale; // steps per meter
   int escale; // steps per meter
   int lenable, lon, pwmmin, pwmmax, pwmfreq; // laser enable, laser on and pwm min/max [%] and frequency [Hz];
+  int lshiftpos, lshiftneg; // bitmap lines in +x and -x direction switch the laser this much early [um]
+  int lppi, lpulse; // pulse the laser on lines: pulses per inch (0: continuous) and pulse length [usec]
   int exhaust, exhaust_offdelay; // How long to continue powering air 
   int dir_us, pulse_us; // extra wait time for longer pulse/dir
 	// nozzle/exhaust after job has ended (seconds).
@@ -50,6 +50,8 @@
 #include "ConfigFile.h"
 #include "EthConfig.h"
 #include "TFTPServer.h"
+#include "JobServer.h"
+#include "StatusServer.h"
 #include "LaosMenu.h"
 #include "LaosMotion.h"
 #include "SDFileSystem.h"
@@ -66,6 +68,8 @@ LaosFileSystem sd(p11, p12, p13, p14, "sd");
 LaosDisplay *dsp;
 LaosMenu *mnu;
 TFTPServer *srv;
+JobServer *jobsrv;
+StatusServer *statsrv;
 LaosMotion *mot;
 Timer systime;
 
@@ -109,6 +113,7 @@ int main()
     printf("SD: READY...\n");
     fclose(fp);
     removefile(testfile);
+    sd.migrate();
   }
   
   // See if there's a .bin file on the SD
@@ -120,6 +125,8 @@ int main()
   cfg =  new GlobalConfig("config.txt");
   mnu->SetScreen("CONFIG OK...."); 
   printf("CONFIG OK...\n");
+  sd.set_max_frequency(cfg->sdspeed * 1000);
+  printf("SD: %d kHz\n", sd.frequency() / 1000);
   if (!cfg->nodisplay)
     dsp->testI2C();
   
@@ -131,6 +138,8 @@ int main()
       
   printf("SERVER...\n");
   srv = new TFTPServer(cfg->port);
+  jobsrv = new JobServer(cfg->jobport);
+  statsrv = new StatusServer(cfg->statusport);
   mnu->SetScreen("SERVER OK...."); 
   wait(0.5);
   mnu->SetScreen(10); // IP
@@ -162,6 +171,7 @@ int main()
 
   // clean sd card?
   if (cfg->cleandir) cleandir();
+  sd.scanjobs();
   mnu->SetScreen("");  
 
   if (cfg->nodisplay) {
@@ -181,28 +191,49 @@ void main_nodisplay() {
    while(1) 
   {  
     int filecnt = srv->fileCnt();
+    int jobcnt = jobsrv->fileCnt();
     mnu->SetScreen("Wait for file ...");
-    while (srv->State() == listen)
+    while ((srv->State() == listen) && (jobsrv->State() != jobreceiving) && (jobcnt == jobsrv->fileCnt())) {
         srv->poll();
+        jobsrv->poll();
+        statsrv->poll();
+    }
     if (srv->State() != listen) {
       mnu->SetScreen("Receive file");
       while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
     }
-    if (filecnt < srv->fileCnt()) {
+    if (jobsrv->State() == jobreceiving) {
+      mnu->SetScreen("Receive file");
+      while ((! mnu->Cancel()) && (jobsrv->State() == jobreceiving)) jobsrv->poll();
+    }
+    char name[32] = "";
+    if (filecnt < srv->fileCnt())
+      srv->getFilename(name);
+    else if (jobcnt < jobsrv->fileCnt())
+      jobsrv->getFilename(name);
+    if (strlen(name)) {
       mot->reset();
       plan_get_current_position_xyz(&x, &y, &z);
        printf("%f %f\n", x,y); 
        mnu->SetScreen("Laser BUSY..."); 
     
-       char name[32];
-       srv->getFilename(name);
        printf("Now processing file: '%s'\n\r", name);
        FILE *in = sd.openfile(name, "r");
-       while (!feof(in))
+       LaosReadAhead rd;
+       rd.open(in);
+       statsrv->jobStart(name, &rd);
+       while (!rd.eof())
        { 
-         while (!mot->ready() );
-         mot->write(readint(in));
+         while (!mot->ready() ) {
+           statsrv->poll();
+           rd.prefetch();
+         }
+         mot->write(readint(&rd));
        }
+       mot->finish(); // in case the file ends in a streamed row or a move
+       statsrv->jobEnd();
+       printf("Read ahead: %lu hits, %lu misses\n", rd.hits, rd.misses);
+       rd.close();
        fclose(in);
        removefile(name);
        // done
@@ -220,15 +251,25 @@ void main_menu() {
   mnu->SetScreen(1);
   while (1) {
     int filecnt = srv->fileCnt();
+    int jobcnt = jobsrv->fileCnt();
     mnu->Handle();
     srv->poll();
+    jobsrv->poll();
+    statsrv->poll();
     if (srv->State() != listen) {
       mnu->SetScreen("Receive file");
 	  while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
     }
-    if (filecnt < srv->fileCnt()) {
-      char myname[32];
+    if (jobsrv->State() == jobreceiving) {
+      mnu->SetScreen("Receive file");
+      while ((! mnu->Cancel()) && (jobsrv->State() == jobreceiving)) jobsrv->poll();
+    }
+    char myname[32] = "";
+    if (filecnt < srv->fileCnt())
       srv->getFilename(myname);
+    else if (jobcnt < jobsrv->fileCnt())
+      jobsrv->getFilename(myname);
+    if (strlen(myname)) {
       if (isFirmware(myname)) {
         installFirmware(myname);
         mnu->SetScreen(1);
@@ -0,0 +1,155 @@
+/**
+ * bitmapstream_test.cpp
+ * Host test of streamed bitmap rows: the pixel ring, the reader waiting for it and the stepper braking for data
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <thread>
+#include <vector>
+#include "global.h"
+#include "LaosMotion.h"
+#include "stepper.h"
+#include "check.h"
+
+#define ROW_PIXELS 50000    // pixels of a row, more than fit in the ring
+#define ROW_LENGTH 2500     // [mm], 0.05 mm pixels
+#define ROW_STEPS (ROW_LENGTH * 40) // 40 steps/mm
+
+GlobalConfig settings;
+GlobalConfig *cfg = &settings;
+
+extern volatile int32_t actpos_x;
+
+// the row that is being burned, as the simulation checks it
+static struct {
+    volatile bool active;
+    std::vector<unsigned long> data;
+    int32_t counter, pixel; // Bresenham of the pixels, as in the stepper
+    int steps, wrong;       // step events, with the laser not as the pixel
+    int holds, abrupt;      // stops for data, at more than the lowest speed
+    unsigned int slowest;   // period of the first step event [usec]
+    unsigned int last;      // period of the last step event [usec]
+    bool held;
+    float fullpwm, holdpwm; // pwm at the nominal speed, and before a stop
+} row;
+
+static volatile bool stop = false;
+
+// the step interrupt and the timeouts, until the test is done
+static void simulate() {
+    while (!stop) {
+        int32_t pos = actpos_x;
+        Ticker *t = Ticker::run(100);
+        if ((t == NULL) || !row.active)
+            continue;
+        if (pos == actpos_x) { // no step event: waiting for data
+            if ((row.steps > 0) && (row.steps < ROW_STEPS) && !row.held) {
+                row.held = true;
+                row.holds++;
+                if (row.last < row.slowest / 2)
+                    row.abrupt++;
+                if (pwm.value > row.holdpwm)
+                    row.holdpwm = pwm.value;
+            }
+            continue;
+        }
+        if (row.steps == 0) {
+            row.counter = -(ROW_STEPS >> 1);
+            row.pixel = 0;
+            row.slowest = t->period;
+        }
+        if (row.held && (t->period < row.slowest / 2))
+            row.abrupt++; // started again at speed
+        row.held = false;
+        row.last = t->period;
+        if (pwm.value > row.fullpwm)
+            row.fullpwm = pwm.value;
+        // the laser as set for this step event, LASERON is 0
+        int on = (row.data[row.pixel / 32] >> (row.pixel % 32)) & 1;
+        if (*laser != (on ? LASERON : LASEROFF))
+            row.wrong++;
+        row.counter += ROW_PIXELS;
+        if (row.counter > 0) {
+            row.counter -= ROW_STEPS;
+            row.pixel++;
+        }
+        row.steps++;
+    }
+}
+
+// send a streamed row to x, the card reads one word per word_us
+static void streamrow(LaosMotion *mot, int x, unsigned int word_us, unsigned long seed) {
+    int words = (ROW_PIXELS + 31) / 32;
+    row.data.resize(words);
+    for (int i=0; i < words; i++) {
+        seed = seed * 1103515245 + 12345;
+        row.data[i] = (seed >> 8) ^ (seed << 13);
+    }
+    row.steps = row.wrong = row.holds = row.abrupt = 0;
+    row.held = false;
+    row.fullpwm = row.holdpwm = 0;
+    row.active = true;
+    int header[] = { 11, x, 0, 1, ROW_PIXELS };
+    for (int i=0; i < 5; i++)
+        mot->write(header[i]);
+    uint64_t start = sim_time();
+    for (int i=0; i < words; i++) {
+        while (sim_time() < start + (uint64_t)i * word_us); // the card is this slow
+        mot->write((int)row.data[i]);
+    }
+    row.active = false;
+}
+
+int main() {
+    cfg->enable = 1;
+    cfg->xscale = cfg->yscale = cfg->zscale = cfg->escale = 40000;
+    cfg->speed = cfg->xspeed = cfg->yspeed = cfg->zspeed = cfg->espeed = 100;
+    cfg->accel = cfg->xaccel = 1000;
+    cfg->tolerance = 50;
+    cfg->xmax = cfg->ymax = 3000000;
+    LaosMotion *mot = new LaosMotion();
+    std::thread sim(simulate);
+    mot->write(7); mot->write(101); mot->write(5000); // power 50%
+
+    // the card is faster than the head: the reader waits for the ring
+    streamrow(mot, ROW_LENGTH * 1000, 4000, 1);
+    CHECK(actpos_x == ROW_STEPS);
+    CHECK(row.steps == ROW_STEPS);
+    CHECK(row.wrong == 0);
+    CHECK(row.abrupt == 0);
+    unsigned long underruns = st_get_underruns();
+
+    // the card is at half the speed of the head: the head slows down and
+    // stops for data, and speeds up again
+    streamrow(mot, 0, 32000, 2);
+    CHECK(actpos_x == 0);
+    CHECK(row.steps == ROW_STEPS);
+    CHECK(row.wrong == 0);
+    CHECK(row.holds > 0);
+    CHECK(st_get_underruns() > underruns);
+    CHECK(row.abrupt == 0);
+    CHECK(row.holdpwm < row.fullpwm / 2); // the power follows the speed
+    printf("%d stops for data\n", row.holds);
+
+    stop = true;
+    sim.join();
+    return check_result();
+}
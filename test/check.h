@@ -0,0 +1,47 @@
+/**
+ * check.h
+ * Minimal checks for the host tests
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <stdio.h>
+
+static int check_failed = 0;
+
+// report a failed condition and go on with the test
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failed++; \
+        } \
+    } while (0)
+
+// exit code of the test
+static inline int check_result() {
+    if (check_failed)
+        printf("%d checks failed\n", check_failed);
+    else
+        printf("ok\n");
+    return (check_failed ? 1 : 0);
+}
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * estimator_test.cpp
+ * Host test of the run time estimate: known moves against the trapezoids worked out by hand
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <math.h>
+#include "global.h"
+#include "config.h"
+#include "LaosEstimator.h"
+#include "check.h"
+
+#define ACCEL 200           // [mm/sec2]
+#define FEED 6000           // [mm/min], 100 mm/sec
+#define DEVIATION 0.05      // junction deviation [mm]
+
+GlobalConfig settings;
+GlobalConfig *cfg = &settings;
+extern config_t config;
+
+// the planner is not run, only its speed model is used
+void st_wake_up() {}
+void st_synchronize() {}
+volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e;
+
+// equal within 1 ms (or 0.1%)
+static bool near(float a, float b) {
+    return fabs(a - b) <= 0.001 + 0.001 * fabs(b);
+}
+
+// time of the moves [sec], starting and ending at x,y = 0,0
+static float run(LaosEstimator *est, const float (*xy)[2], int n, unsigned long *stops) {
+    est->Reset();
+    est->SetPosition(0, 0);
+    for (int i=0; i < n; i++)
+        est->Move(xy[i][0], xy[i][1], FEED, ACCEL);
+    est->Flush();
+    *stops = est->Stops();
+    return est->Time();
+}
+
+int main() {
+    LaosEstimator est;
+    unsigned long stops;
+    float u0[NUM_AXES] = { 1, 0, 0, 0 }, u90[NUM_AXES] = { 0, 1, 0, 0 };
+    float u180[NUM_AXES] = { -1, 0, 0, 0 };
+    config.maximum_feedrate_x = config.maximum_feedrate_y = 60 * 1000;
+    config.maximum_feedrate_z = config.maximum_feedrate_e = 60 * 1000;
+    config.acceleration = ACCEL;
+    config.junction_deviation = DEVIATION;
+
+    // the planner: speed [mm/min] that can still brake to 0 in 25 mm,
+    // v^2 = 2 a d = 10000 mm2/sec2
+    CHECK(near(plan_max_allowable_speed(-ACCEL, 0, 25), 6000));
+    // and the junction speeds: straight on at the lower speed, reversing
+    // at 0, a right angle from the circle through the junction deviation,
+    // sin(45 deg) / (1 - sin(45 deg)) = 1 + sqrt(2)
+    CHECK(near(plan_junction_speed(u0, FEED, u0, FEED/2, ACCEL), FEED/2));
+    CHECK(plan_junction_speed(u0, FEED, u180, FEED, ACCEL) == 0);
+    float corner = sqrt(ACCEL * DEVIATION * (1 + sqrt(2))); // [mm/sec]
+    CHECK(near(plan_junction_speed(u0, FEED, u90, FEED, ACCEL), corner * 60));
+
+    // 100 mm: 0.5 sec and 25 mm up to 100 mm/sec, 50 mm at speed, 0.5 sec down
+    const float line[][2] = { { 100, 0 } };
+    CHECK(near(run(&est, line, 1, &stops), 1.5));
+    CHECK(stops == 1);
+
+    // 10 mm: the speed peaks at sqrt(a d) = sqrt(2000) mm/sec halfway
+    const float shortline[][2] = { { 10, 0 } };
+    CHECK(near(run(&est, shortline, 1, &stops), 2 * sqrt(2000.0) / ACCEL));
+    CHECK(stops == 1);
+
+    // the same 100 mm in two moves: no stop in between
+    const float split[][2] = { { 50, 0 }, { 100, 0 } };
+    CHECK(near(run(&est, split, 2, &stops), 1.5));
+    CHECK(stops == 1);
+
+    // 60 mm forward and back: two full stops of 1.1 sec
+    const float back[][2] = { { 60, 0 }, { 0, 0 } };
+    CHECK(near(run(&est, back, 2, &stops), 2.2));
+    CHECK(stops == 2);
+
+    // a right angle: both 50 mm moves slow down to the corner speed
+    const float square[][2] = { { 50, 0 }, { 50, 50 } };
+    float brake = (100 - corner) / ACCEL;   // 100 mm/sec down to the corner speed
+    float brakemm = (100 * 100 - corner * corner) / (2 * ACCEL);
+    float move = 0.5 + brake + (50 - 25 - brakemm) / 100;
+    CHECK(near(run(&est, square, 2, &stops), 2 * move));
+    CHECK(stops == 1);
+
+    // more moves than the planner looks ahead: the estimate stays the same
+    float many[40][2];
+    for (int i=0; i < 40; i++) {
+        many[i][0] = (i + 1) * 2.5;
+        many[i][1] = 0;
+    }
+    CHECK(near(run(&est, many, 40, &stops), 1.5));
+    CHECK(stops == 1);
+
+    return check_result();
+}
@@ -0,0 +1,97 @@
+/**
+ * jobserver_test.cpp
+ * Host test of the TCP job server: the spool protocol over a loopback socket
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "JobServer.h"
+#include "check.h"
+
+Loopback loopback;
+LaosFileSystem sd;
+Timer systime;
+
+// a client connects and sends the chunks, the server is polled until it is idle again
+static void upload(JobServer *srv, const char **chunks, bool close) {
+    loopback.connecting = true;
+    loopback.sent.clear();
+    for (int i=0; chunks[i] != NULL; i++)
+        loopback.sent.push_back(chunks[i]);
+    loopback.closed = close;
+    loopback.reply = "";
+    loopback.dropped = false;
+    for (int i=0; i < 100; i++) {
+        srv->poll();
+        if ((i > 0) && (srv->State() == jobidle))
+            break;
+    }
+}
+
+int main() {
+    strcpy(sd.pathname, "sdcard/");
+    JobServer *srv = new JobServer(2000);
+    CHECK(srv->State() == jobidle);
+
+    // size given: the header and the data are split over the packets
+    const char *sized[] = { "job1.l", "c 12\n1 2 3", " 4 5 6\n", NULL };
+    upload(srv, sized, false);
+    CHECK(loopback.reply == "OK\n");
+    CHECK(loopback.dropped);
+    CHECK(contents("job1.lc") == "1 2 3 4 5 6\n");
+    CHECK(strcmp(sd.lastjob, "job1.lc") == 0);
+    CHECK(srv->fileCnt() == 1);
+
+    // data after the announced size is ignored
+    const char *trailing[] = { "job2.lc 4\n0 1\ngarbage", NULL };
+    upload(srv, trailing, false);
+    CHECK(loopback.reply == "OK\n");
+    CHECK(contents("job2.lc") == "0 1\n");
+
+    // no size: the file ends when the client closes
+    const char *unsized[] = { "job3.lc\n", "7 100 50\n", "1 10 10\n", NULL };
+    upload(srv, unsized, true);
+    CHECK(loopback.reply == "");
+    CHECK(contents("job3.lc") == "7 100 50\n1 10 10\n");
+    CHECK(srv->fileCnt() == 3);
+
+    // closed before the announced size: the partial file is removed
+    const char *partial[] = { "job4.lc 100\n1 2 3\n", NULL };
+    upload(srv, partial, true);
+    CHECK(loopback.reply == "ERR connection closed\n");
+    CHECK(contents("job4.lc") == "<none>");
+    CHECK(srv->fileCnt() == 3);
+
+    // the client stops sending: the connection times out
+    const char *stalled[] = { "job5.lc 100\n1 2", NULL };
+    upload(srv, stalled, false);
+    CHECK(srv->State() == jobreceiving);
+    systime.us += (JOBSERVER_TIMEOUT + 1) * 1000;
+    srv->poll();
+    CHECK(loopback.reply == "ERR timeout\n");
+    CHECK(srv->State() == jobidle);
+    CHECK(contents("job5.lc") == "<none>");
+
+    // no filename
+    const char *noname[] = { "\n", NULL };
+    upload(srv, noname, false);
+    CHECK(loopback.reply == "ERR no filename\n");
+
+    delete srv;
+    return check_result();
+}
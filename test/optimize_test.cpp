@@ -0,0 +1,127 @@
+/**
+ * optimize_test.cpp
+ * Host test of the path optimizer: the new order and the replacement of the job
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "laosoptimize.h"
+#include "global.h"
+#include "check.h"
+#include <sys/stat.h>
+
+LaosFileSystem sd;
+GlobalConfig config;
+GlobalConfig *cfg = &config;
+
+// paths at x = 100, 0 and 50 mm, between two power settings
+static const char *job =
+    "7 101 50\n"
+    "0 100000 0\n1 110000 0\n"
+    "0 0 0\n1 10000 0\n"
+    "0 50000 0\n1 60000 0\n"
+    "7 101 20\n";
+
+// the nearest path first, the last path before the power change stays last
+static const char *reordered =
+    "7 101 50\n"
+    "0 0 0\n1 10000 0\n"
+    "0 100000 0\n1 110000 0\n"
+    "0 50000 0\n1 60000 0\n"
+    "7 101 20\n";
+
+// a bitmap for the path at x = 100 mm, which is not the nearest
+static const char *bitmapjob =
+    "9 1 32 -1\n"
+    "0 100000 0\n1 110000 0\n"
+    "0 0 0\n1 10000 0\n"
+    "0 90000 0\n1 100000 0\n"
+    "0 50000 0\n1 60000 0\n"
+    "7 101 20\n";
+
+// the bitmap path stays first, the paths after it are reordered
+static const char *bitmapreordered =
+    "9 1 32 -1\n"
+    "0 100000 0\n1 110000 0\n"
+    "0 90000 0\n1 100000 0\n"
+    "0 0 0\n1 10000 0\n"
+    "0 50000 0\n1 60000 0\n"
+    "7 101 20\n";
+
+static void putfile(const char *name, const char *data) {
+    FILE *fp = sd.openfile((char*)name, "wb");
+    fputs(data, fp);
+    fclose(fp);
+}
+
+int main() {
+    char name[] = "job.lc";
+    char firmware[] = "firmware.bin";
+    strcpy(sd.pathname, "sdcard/");
+
+    // sys.optimize off: the job is left alone
+    putfile(name, job);
+    CHECK(optimizejob(name) == 0);
+    CHECK(contents(name) == job);
+
+    // the job is replaced by the new order, no temporary files are left
+    cfg->optimize = 1;
+    CHECK(optimizejob(name) == 1);
+    CHECK(contents(name) == reordered);
+    CHECK(contents(_LAOSFILE_OPTIMIZE) == "<none>");
+    CHECK(contents(_LAOSFILE_REPLACED) == "<none>");
+
+    // nothing to gain: the job stays as it is
+    CHECK(optimizejob(name) == 0);
+    CHECK(contents(name) == reordered);
+    CHECK(contents(_LAOSFILE_OPTIMIZE) == "<none>");
+
+    // the line after a bitmap keeps the bitmap
+    putfile(name, bitmapjob);
+    CHECK(optimizejob(name) == 1);
+    CHECK(contents(name) == bitmapreordered);
+
+    // as does the line after a run length coded bitmap
+    std::string rle = std::string("10 32 2 8 24") + strchr(bitmapjob, '\n');
+    putfile(name, rle.c_str());
+    CHECK(optimizejob(name) == 1);
+    CHECK(contents(name) == std::string("10 32 2 8 24") + strchr(bitmapreordered, '\n'));
+
+    // and the line after an end power: it ramps the power
+    std::string ramp = std::string("7 103 80") + strchr(bitmapjob, '\n');
+    putfile(name, ramp.c_str());
+    CHECK(optimizejob(name) == 1);
+    CHECK(contents(name) == std::string("7 103 80") + strchr(bitmapreordered, '\n'));
+
+    // firmware is not a job
+    putfile(firmware, job);
+    CHECK(optimizejob(firmware) == 0);
+    CHECK(contents(firmware) == job);
+
+    // the job can not be moved aside: it is kept, the new order is dropped
+    putfile(name, job);
+    mkdir("sdcard/" _LAOSFILE_REPLACED, 0777);
+    putfile(_LAOSFILE_REPLACED "/busy", "");
+    CHECK(optimizejob(name) == 0);
+    CHECK(contents(name) == job);
+    CHECK(contents(_LAOSFILE_OPTIMIZE) == "<none>");
+
+    return check_result();
+}
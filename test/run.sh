@@ -0,0 +1,50 @@
+#!/bin/bash
+#
+# run.sh
+# Build and run the host tests: parts of the firmware compiled on the PC
+# against the stand-ins in test/stubs, no mbed library or board needed.
+# The sources under test are copied to the build directory, so their
+# includes find the stand-ins instead of their neighbours in laser/.
+#
+# usage: test/run.sh [test ...]   (default: all tests)
+#
+cd `dirname $0`
+CXX=${CXX:-g++}
+BUILD=build
+LASER=../laser
+TESTS=${@:-jobserver sdcard estimator optimize bitmapstream}
+FAILED=0
+
+for t in $TESTS; do
+  rm -rf $BUILD/$t
+  mkdir -p $BUILD/$t/sdcard
+  case $t in
+    jobserver)
+      cp $LASER/LaosServer/JobServer/JobServer.* $BUILD/$t
+      INC="-Istubs/jobserver -Istubs"
+      ;;
+    sdcard)
+      cp $LASER/SDFileSystem/SDFileSystem.* $BUILD/$t
+      INC="-Istubs -Wno-sign-compare"
+      ;;
+    estimator)
+      cp $LASER/LaosExtent/LaosEstimator.* $LASER/LaosMotion/grbl/planner.* $LASER/LaosMotion/grbl/config.h $LASER/LaosMotion/grbl/stepper.h $BUILD/$t
+      INC="-Istubs -Wno-format -Wno-sign-compare"
+      ;;
+    optimize)
+      cp $LASER/LaosFile/laosoptimize.* $BUILD/$t
+      INC="-Istubs"
+      ;;
+    bitmapstream)
+      cp $LASER/LaosMotion/LaosMotion.* $LASER/LaosMotion/pins.* $LASER/LaosMotion/grbl/* $BUILD/$t
+      INC="-Istubs -pthread -Wno-format -Wno-sign-compare"
+      ;;
+  esac
+  echo "== $t"
+  if ! $CXX -g -Wall -Wno-unused -I$BUILD/$t $INC -o $BUILD/$t/test ${t}_test.cpp $BUILD/$t/*.cpp ; then
+    FAILED=1
+    continue
+  fi
+  (cd $BUILD/$t && ./test) || FAILED=1
+done
+exit $FAILED
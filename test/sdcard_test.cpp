@@ -0,0 +1,119 @@
+/**
+ * sdcard_test.cpp
+ * Host test of the SD card driver against the card model: multiple block runs, CRC errors and retries
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "SDFileSystem.h"
+#include "sdcard.h"
+#include "check.h"
+
+// the driver, with its chip select in reach of the card model
+class TestSD : public SDFileSystem {
+    public:
+        TestSD() : SDFileSystem(p5, p6, p7, p8, "sd") {}
+        DigitalOut* cs() { return &_cs; }
+};
+
+// a different byte pattern for each sector and pass
+static void fill(uint8_t *buf, int sectors, int seed) {
+    for (int i=0; i < sectors * 512; i++)
+        buf[i] = (uint8_t)(i * 7 + seed + (i >> 9) * 13);
+}
+
+int main() {
+    static uint8_t buf[16 * 512], back[16 * 512];
+    TestSD sd;
+    SDCard card(sd.cs());
+    SPI::device() = &card;
+
+    // init: SDHC card, the clock from the CSD up to the ceiling
+    sd.set_max_frequency(20000000);
+    CHECK(sd.disk_initialize() == 0);
+    CHECK(sd.disk_sectors() == SDCARD_SECTORS);
+    CHECK(sd.frequency() == 20000000);
+    CHECK(card.commands[59] == 1);
+
+    // a run of sectors is written with CMD25 and read with CMD18 and CMD12
+    fill(buf, 16, 1);
+    CHECK(sd.disk_write(buf, 100, 16) == 0);
+    CHECK(card.commands[25] == 1);
+    CHECK(card.blockswritten == 16);
+    CHECK(memcmp(&card.data[100 * 512], buf, sizeof(buf)) == 0);
+    CHECK(sd.disk_read(back, 100, 16) == 0);
+    CHECK(card.commands[18] == 1);
+    CHECK(card.commands[12] == 1);
+    CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+
+    // one sector: CMD17 and CMD24
+    fill(buf, 1, 2);
+    CHECK(sd.disk_write(buf, 7, 1) == 0);
+    CHECK(card.commands[24] == 1);
+    CHECK(sd.disk_read(back, 7, 1) == 0);
+    CHECK(card.commands[17] == 1);
+    CHECK(memcmp(back, buf, 512) == 0);
+    CHECK(memcmp(&card.data[100 * 512], back, 512) != 0);  // the run is still there
+
+    // runs follow each other: the card is back in command mode after CMD12
+    CHECK(sd.disk_read(back, 100, 4) == 0);
+    CHECK(sd.disk_read(back + 4 * 512, 104, 4) == 0);
+    fill(buf, 16, 1);
+    CHECK(memcmp(back, buf, 8 * 512) == 0);
+    CHECK(card.commands[18] == 3);
+    CHECK(card.commands[12] == 3);
+
+    // a garbled block in a run: the CRC16 catches it, the run is read again
+    // at half the clock
+    card.badreads = 1;
+    memset(back, 0, sizeof(back));
+    CHECK(sd.disk_read(back, 100, 16) == 0);
+    CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+    CHECK(card.commands[18] == 5);
+    CHECK(card.commands[12] == 5);
+    CHECK(sd.frequency() == 10000000);
+
+    // a block that reaches the card garbled is rejected, the run is written again
+    fill(buf, 8, 3);
+    card.badwrites = 1;
+    CHECK(sd.disk_write(buf, 200, 8) == 0);
+    CHECK(card.commands[25] == 3);
+    CHECK(memcmp(&card.data[200 * 512], buf, 8 * 512) == 0);
+    CHECK(sd.frequency() == 5000000);
+
+    // a garbled command is refused by its CRC7
+    card.badcommands = 1;
+    CHECK(sd.disk_read(back, 200, 8) == 0);
+    CHECK(memcmp(back, buf, 8 * 512) == 0);
+    CHECK(sd.frequency() == 2500000);
+
+    // errors that do not go away: give up at the lowest clock
+    card.badreads = 100;
+    CHECK(sd.disk_read(back, 200, 8) != 0);
+    CHECK(sd.frequency() == 1000000);
+    card.badreads = 0;
+
+    // beyond the end of the card
+    CHECK(sd.disk_read(back, SDCARD_SECTORS - 2, 4) != 0);
+    CHECK(sd.disk_read(back, SDCARD_SECTORS - 2, 2) == 0);
+    CHECK(memcmp(back, &card.data[(SDCARD_SECTORS - 2) * 512], 1024) == 0);
+
+    return check_result();
+}
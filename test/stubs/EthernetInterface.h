@@ -0,0 +1,80 @@
+/**
+ * EthernetInterface.h
+ * Host stand-in for the mbed TCP sockets: a loopback, the test plays the
+ * client. There is one connection at a time, as in the servers.
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ETHERNETINTERFACE_H_
+#define ETHERNETINTERFACE_H_
+
+#include <string>
+#include <deque>
+
+// the client side of the loopback
+typedef struct {
+    bool connecting;                // the client connects, accept() takes it
+    std::deque<std::string> sent;   // data the client sent, one receive() per chunk at most
+    bool closed;                    // the client closed its side
+    std::string reply;              // data the server sent
+    bool dropped;                   // the server closed the connection
+} Loopback;
+
+extern Loopback loopback;
+
+class TCPSocketConnection {
+    public:
+        void set_blocking(bool blocking, unsigned int timeout) {}
+        // -1: nothing received (non blocking), 0: closed by the client
+        int receive(char *data, int length) {
+            if (loopback.sent.empty())
+                return (loopback.closed ? 0 : -1);
+            std::string &chunk = loopback.sent.front();
+            int len = ((int)chunk.size() < length ? (int)chunk.size() : length);
+            memcpy(data, chunk.data(), len);
+            chunk.erase(0, len);
+            if (chunk.empty())
+                loopback.sent.pop_front();
+            return len;
+        }
+        int send_all(char *data, int length) {
+            loopback.reply.append(data, length);
+            return length;
+        }
+        int close() {
+            loopback.dropped = true;
+            return 0;
+        }
+};
+
+class TCPSocketServer {
+    public:
+        int bind(int port) { return 0; }
+        int listen(int max=1) { return 0; }
+        void set_blocking(bool blocking, unsigned int timeout) {}
+        int accept(TCPSocketConnection &connection) {
+            if (!loopback.connecting)
+                return -1;
+            loopback.connecting = false;
+            return 0;
+        }
+        int close() { return 0; }
+};
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * FATFileSystem.h
+ * Host stand-in for the FatFs wrapper: only the disk interface of the drivers
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MBED_FATFILESYSTEM_H
+#define MBED_FATFILESYSTEM_H
+
+#include <stdint.h>
+
+class FATFileSystem {
+public:
+    FATFileSystem(const char* n) {}
+    virtual ~FATFileSystem() {}
+    virtual int disk_initialize() { return 0; }
+    virtual int disk_status() { return 0; }
+    virtual int disk_read(uint8_t * buffer, uint64_t sector) = 0;
+    virtual int disk_write(const uint8_t * buffer, uint64_t sector) = 0;
+    virtual int disk_read(uint8_t * buffer, uint64_t sector, int count) = 0;
+    virtual int disk_write(const uint8_t * buffer, uint64_t sector, int count) = 0;
+    virtual int disk_sync() { return 0; }
+    virtual uint64_t disk_sectors() = 0;
+};
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * global.h
+ * Host stand-in for the controller configuration (see laser/global.h)
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _GLOBAL_H_
+#define _GLOBAL_H_
+
+#include "mbed.h"
+#include <string>
+
+// only the settings the tested code reads, see config/config.txt
+class GlobalConfig {
+    public:
+        GlobalConfig() { memset(this, 0, sizeof(*this)); pwmfreq = 1000; pwmmax = 100; }
+        int BedHeight() const { return zmax; }
+        int optimize;
+        int enable, autozhome;
+        int xmax, ymax, zmax, xmin, ymin, zmin;
+        int xpol, ypol, zpol, xinv, yinv, zinv, einv;
+        int xhomedir, yhomedir, zhomedir, homespeed, zhomespeed;
+        int speed, xspeed, yspeed, zspeed, espeed, accel, xaccel, tolerance;
+        int xscale, yscale, zscale, escale;
+        int lenable, pwmmin, pwmmax, pwmfreq, lshiftpos, lshiftneg, lppi, lpulse;
+        int exhaust_offdelay, dir_us, pulse_us;
+};
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * laosjobindex.h
+ * Host stand-in for the job index, for the JobServer test
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _LAOSJOBINDEX_H_
+#define _LAOSJOBINDEX_H_
+
+#include "laosfilesystem.h"
+
+class LaosJobAnalyzer {
+    public:
+        LaosJobAnalyzer() { bytes = 0; }
+        void start(char *name) { bytes = 0; }
+        void write(const char *data, int len) { bytes += len; }
+        void finish(char *name) { printf("analyzed %s: %ld bytes\n", name, bytes); }
+    private:
+        long bytes;
+};
+
+inline void indexjob(char *name) {}
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * laosfilesystem.h
+ * Host stand-in for the SD file system: files are in a directory on the PC
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _LAOSFILESYSTEM_H_
+#define _LAOSFILESYSTEM_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define _LAOSFILE_OPTIMIZE "optimize.sys"
+#define _LAOSFILE_REPLACED "replaced.sys"
+#define MAXFILESIZE 21
+#define SHORTFILESIZE 13
+
+class LaosFileSystem {
+    public:
+        LaosFileSystem() { strcpy(pathname, ""); strcpy(lastjob, ""); }
+        FILE* openfile(char* name, const std::string& iom) {
+            char fullname[sizeof(pathname)+MAXFILESIZE];
+            sprintf(fullname, "%s%s", pathname, name);
+            return fopen(fullname, iom.c_str());
+        }
+        void addjob(char* name) { strcpy(lastjob, name); }
+        void shorten(char* name, int max) {
+            if ((int)strlen(name) >= max)
+                name[max-1] = 0;
+        }
+        char pathname[MAXFILESIZE+2];   // directory of the files, ends in '/'
+        char lastjob[MAXFILESIZE];  // last job added to the job list
+};
+
+extern LaosFileSystem sd;
+
+inline void removefile(char *name) {
+    char fullname[sizeof(sd.pathname)+MAXFILESIZE];
+    sprintf(fullname, "%s%s", sd.pathname, name);
+    remove(fullname);
+}
+
+// like the simplecode parser: integers separated by white space
+inline int readint(FILE *fp) {
+    int val = 0;
+    if (fscanf(fp, "%d", &val) != 1)
+        return 0;
+    return val;
+}
+
+// for the tests: contents of a file on the card, "<none>" if there is none
+inline std::string contents(const char *name) {
+    std::string s;
+    FILE *fp = sd.openfile((char*)name, "rb");
+    if (fp == NULL)
+        return "<none>";
+    int c;
+    while ((c = fgetc(fp)) != EOF)
+        s += (char)c;
+    fclose(fp);
+    return s;
+}
+
+inline int isFirmware(char *name) {
+    int len = strlen(name);
+    return (len > 4) && (strcasecmp(&name[len-4], ".bin") == 0);
+}
+
+#endif
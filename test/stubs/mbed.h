@@ -0,0 +1,155 @@
+/**
+ * mbed.h
+ * Host stand-in for the parts of the mbed library that the host tests use
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <mutex>
+
+// the test sets the time: us is returned by read_us()
+class Timer {
+    public:
+        Timer() { us = 0; }
+        void start() {}
+        int read_us() { return us; }
+        int read_ms() { return us / 1000; }
+        unsigned int us;
+};
+
+inline void wait(float s) {}
+inline void wait_us(int us) {}
+inline void wait_ms(int ms) {}
+inline void sleep_mode() {}
+
+// pins keep the last value written
+typedef int PinName;
+enum { p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18, p19,
+    p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30, LED1, LED2, LED3, LED4 };
+enum PinMode { PullUp, PullDown, PullNone };
+
+class DigitalOut {
+    public:
+        DigitalOut(PinName pin) { value = 0; }
+        DigitalOut& operator=(int v) { value = v; return *this; }
+        DigitalOut& operator=(DigitalOut &d) { value = d.value; return *this; }
+        operator int() { return value; }
+        volatile int value;
+};
+
+class DigitalIn {
+    public:
+        DigitalIn(PinName pin) { value = 0; }
+        void mode(PinMode mode) {}
+        operator int() { return value; }
+        int value;
+};
+
+class PwmOut {
+    public:
+        PwmOut(PinName pin) { value = 0; }
+        void period(float s) {}
+        PwmOut& operator=(float v) { value = v; return *this; }
+        operator float() { return value; }
+        volatile float value;
+};
+
+// a device on the SPI bus: gets the byte the host sends, returns the
+// byte it shifts out at the same time
+class SPIDevice {
+    public:
+        virtual ~SPIDevice() {}
+        virtual int transfer(int value) = 0;
+};
+
+// the test connects a device (see sdcard.h), without one the bus reads 0xFF
+class SPI {
+    public:
+        SPI(PinName mosi, PinName miso, PinName sclk) { hz = 1000000; }
+        void frequency(int hz) { this->hz = hz; }
+        int write(int value) { return (device() != NULL ? device()->transfer(value & 0xFF) : 0xFF); }
+        static SPIDevice*& device() { static SPIDevice *dev = NULL; return dev; }
+        int hz;
+};
+
+// Interrupts are simulated: the test runs the tickers and timeouts that
+// are due in a thread of its own (see Ticker::run), with the interrupt
+// lock held, and moves the time of us_ticker_read() to when they are due.
+inline std::recursive_mutex& irq_lock() { static std::recursive_mutex lock; return lock; }
+inline void __disable_irq() { irq_lock().lock(); }
+inline void __enable_irq() { irq_lock().unlock(); }
+inline volatile uint64_t& sim_time() { static volatile uint64_t t = 0; return t; } // [usec]
+inline uint32_t us_ticker_read() { return (uint32_t)sim_time(); }
+
+class Ticker {
+    public:
+        Ticker() { fn = NULL; oneshot = false; next = first(); first() = this; }
+        void attach_us(void (*f)(void), unsigned int us) {
+            __disable_irq();
+            fn = f;
+            period = us;
+            due = sim_time() + us;
+            __enable_irq();
+        }
+        void attach(void (*f)(void), float s) { attach_us(f, (unsigned int)(s * 1000000)); }
+        void detach() { fn = NULL; }
+        // call the first function that is due, advance the time by idle
+        // if none is attached; returns the ticker that was called
+        static Ticker* run(unsigned int idle) {
+            __disable_irq();
+            Ticker *t = NULL;
+            for (Ticker *i = first(); i != NULL; i = i->next)
+                if ((i->fn != NULL) && ((t == NULL) || (i->due < t->due)))
+                    t = i;
+            if (t == NULL) {
+                sim_time() += idle;
+            } else {
+                void (*f)(void) = t->fn;
+                if (t->due > sim_time())
+                    sim_time() = t->due;
+                if (t->oneshot)
+                    t->fn = NULL;
+                else
+                    t->due += t->period;
+                f();
+            }
+            __enable_irq();
+            return t;
+        }
+        static Ticker*& first() { static Ticker *list = NULL; return list; }
+        void (*volatile fn)(void);
+        unsigned int period;    // [usec]
+        uint64_t due;           // [usec]
+        bool oneshot;
+        Ticker *next;
+};
+
+class Timeout : public Ticker {
+    public:
+        Timeout() { oneshot = true; }
+};
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ * sdcard.h
+ * Host model of an SD card on the SPI bus, for the tests of SDFileSystem
+ *
+ * Copyright (c) 2026 the LaOS project contributors
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef SDCARD_H
+#define SDCARD_H
+
+#include <vector>
+#include <deque>
+#include "mbed.h"
+
+#define SDCARD_SECTORS 2048     // 1 MB, the CSD says (C_SIZE + 1) * 1024 sectors
+#define SDCARD_INIT 3           // nr of ACMD41 until the card leaves the idle state
+
+// An SDHC card in SPI mode, as seen from the bus (SD physical layer
+// specification, chapter 7). Commands are checked for their CRC7 (always
+// for CMD0 and CMD8, after CMD59 for all of them) and answered with R1,
+// R3, R7 or a CSD block. Data blocks are sent with their CRC16 and a 0xFE
+// token; after CMD18 they keep coming until CMD12, which is followed by
+// a stuff byte and an R1b. Written blocks are checked for their CRC16
+// (after CMD59) and acknowledged with a data response token and some busy
+// bytes; after CMD25 0xFC starts a block and 0xFD ends the transfer.
+// Bit errors on the bus are made with the bad... counters.
+class SDCard : public SPIDevice {
+    public:
+        SDCard(DigitalOut *cs) : data(SDCARD_SECTORS * 512) {
+            this->cs = cs;
+            memset(commands, 0, sizeof(commands));
+            blocksread = blockswritten = 0;
+            badcommands = badreads = badwrites = 0;
+            idle = app = crc = false;
+            inits = 0;
+            mode = COMMAND;
+        }
+
+        virtual int transfer(int in) {
+            if (cs->value) {    // not selected: the card does not drive the bus
+                frame.clear();
+                return 0xFF;
+            }
+            if (out.empty() && (mode == READING))
+                sendblock(addr++);
+            int value = 0xFF;
+            if (!out.empty()) {
+                value = out.front();
+                out.pop_front();
+            }
+            receive(in);
+            return value;
+        }
+
+        std::vector<uint8_t> data;  // contents of the card
+        int commands[64];           // nr of times each command was received
+        int blocksread, blockswritten;
+        int badcommands;            // nr of commands to garble (with CRC checking on)
+        int badreads, badwrites;    // nr of data blocks to garble on the way
+
+    private:
+        enum { COMMAND, READING, WRITING, WRITINGMULTI, RECEIVING, RECEIVINGMULTI };
+
+        static uint8_t crc7(const uint8_t *d, int n) {
+            uint8_t crc = 0;
+            for (int i=0; i < n*8; i++) {
+                int bit = ((d[i/8] >> (7 - i%8)) & 1) ^ ((crc >> 6) & 1);
+                crc = (crc << 1) & 0x7F;
+                if (bit)
+                    crc ^= 0x09;
+            }
+            return (crc << 1) | 1;
+        }
+
+        static uint16_t crc16(const uint8_t *d, int n) {
+            uint16_t crc = 0;
+            for (int i=0; i < n*8; i++) {
+                int bit = ((d[i/8] >> (7 - i%8)) & 1) ^ (crc >> 15);
+                crc <<= 1;
+                if (bit)
+                    crc ^= 0x1021;
+            }
+            return crc;
+        }
+
+        // a data block, the CRC is of the data before the bus garbles it
+        void sendbytes(const uint8_t *d, int n) {
+            uint16_t c = crc16(d, n);
+            out.push_back(0xFF);    // access time
+            out.push_back(0xFE);
+            for (int i=0; i < n; i++)
+                out.push_back(d[i]);
+            if (badreads > 0) {
+                badreads--;
+                out[out.size() - n/2] ^= 0x10;
+            }
+            out.push_back(c >> 8);
+            out.push_back(c & 0xFF);
+        }
+
+        void sendblock(unsigned long sector) {
+            if (sector >= SDCARD_SECTORS) {
+                out.push_back(0x08);    // error token: out of range
+                mode = COMMAND;
+                return;
+            }
+            sendbytes(&data[sector * 512], 512);
+            blocksread++;
+        }
+
+        void busy(int n) {
+            while (n-- > 0)
+                out.push_back(0x00);
+        }
+
+        void receive(int in) {
+            switch (mode) {
+                case WRITING:       // single block: 0xFE starts the data
+                    if (in == 0xFE) {
+                        block.clear();
+                        mode = RECEIVING;
+                    }
+                    return;
+                case WRITINGMULTI:  // 0xFC: the next block, 0xFD: done
+                    if (in == 0xFC) {
+                        block.clear();
+                        mode = RECEIVINGMULTI;
+                    } else if (in == 0xFD) {
+                        out.push_back(0xFF);
+                        busy(4);
+                        mode = COMMAND;
+                    }
+                    return;
+                case RECEIVING:
+                case RECEIVINGMULTI:
+                    block.push_back(in);
+                    if (block.size() == 514)
+                        receivedblock();
+                    return;
+            }
+            // a command: 01 and the index, 4 bytes argument, CRC7
+            if (frame.empty() && ((in & 0xC0) != 0x40))
+                return;
+            frame.push_back(in);
+            if (frame.size() == 6) {
+                command();
+                frame.clear();
+            }
+        }
+
+        void receivedblock() {
+            if (badwrites > 0) {
+                badwrites--;
+                block[100] ^= 0x01;
+            }
+            uint16_t c = (block[512] << 8) | block[513];
+            bool multi = (mode == RECEIVINGMULTI);
+            mode = (multi ? WRITINGMULTI : COMMAND);
+            if (crc && (c != crc16(&block[0], 512))) {
+                out.push_back(0x0B);    // data rejected: CRC error
+                return;
+            }
+            if (addr >= SDCARD_SECTORS) {
+                out.push_back(0x0D);    // data rejected: write error
+                return;
+            }
+            memcpy(&data[addr * 512], &block[0], 512);
+            blockswritten++;
+            addr++;
+            out.push_back(0x05);        // data accepted
+            busy(3);
+        }
+
+        void command() {
+            int cmd = frame[0] & 0x3F;
+            unsigned long arg = ((unsigned long)frame[1] << 24) | (frame[2] << 16) | (frame[3] << 8) | frame[4];
+            if (crc && (badcommands > 0)) {
+                badcommands--;
+                frame[3] ^= 0x04;
+            }
+            uint8_t r1 = (idle ? 0x01 : 0x00);
+            if ((crc || (cmd == 0) || (cmd == 8)) && (crc7(&frame[0], 5) != frame[5])) {
+                out.push_back(0xFF);
+                out.push_back(r1 | 0x08);  // com crc error
+                return;
+            }
+            commands[cmd]++;
+            bool acmd = app;
+            app = false;
+            if (cmd == 12) {    // the data that was on its way is dropped
+                out.clear();
+                out.push_back(0x3C);    // stuff byte
+                out.push_back(0xFF);
+                out.push_back(r1);
+                busy(2);
+                mode = COMMAND;
+                return;
+            }
+            out.push_back(0xFF);    // command response time
+            switch (cmd) {
+                case 0:
+                    idle = true;
+                    crc = false;
+                    inits = 0;
+                    mode = COMMAND;
+                    out.push_back(0x01);
+                    break;
+                case 8:     // R7: voltage accepted, check pattern
+                    out.push_back(r1);
+                    out.push_back(0x00);
+                    out.push_back(0x00);
+                    out.push_back(arg >> 8);
+                    out.push_back(arg & 0xFF);
+                    break;
+                case 9:     // CSD version 2: 25 MHz, C_SIZE
+                    out.push_back(r1);
+                    if (!idle) {
+                        uint8_t csd[16];
+                        memset(csd, 0, sizeof(csd));
+                        csd[0] = 0x40;
+                        csd[3] = 0x32;
+                        csd[8] = ((SDCARD_SECTORS / 1024 - 1) >> 8) & 0xFF;
+                        csd[9] = (SDCARD_SECTORS / 1024 - 1) & 0xFF;
+                        sendbytes(csd, 16);
+                    }
+                    break;
+                case 16:
+                    out.push_back(arg == 512 ? r1 : (r1 | 0x40));
+                    break;
+                case 17:
+                case 18:
+                    if (arg >= SDCARD_SECTORS) {
+                        out.push_back(r1 | 0x20);  // address error
+                        break;
+                    }
+                    out.push_back(r1);
+                    addr = arg;
+                    if (cmd == 17)
+                        sendblock(addr);
+                    else
+                        mode = READING;
+                    break;
+                case 24:
+                case 25:
+                    if (arg >= SDCARD_SECTORS) {
+                        out.push_back(r1 | 0x20);
+                        break;
+                    }
+                    out.push_back(r1);
+                    addr = arg;
+                    mode = (cmd == 24 ? WRITING : WRITINGMULTI);
+                    break;
+                case 41:
+                    if (acmd && (++inits >= SDCARD_INIT))
+                        idle = false;
+                    out.push_back(acmd ? (idle ? 0x01 : 0x00) : (r1 | 0x04));
+                    break;
+                case 55:
+                    app = true;
+                    out.push_back(r1);
+                    break;
+                case 58:    // R3: OCR with power up done and high capacity
+                    out.push_back(r1);
+                    out.push_back(idle ? 0x00 : 0xC0);
+                    out.push_back(0xFF);
+                    out.push_back(0x80);
+                    out.push_back(0x00);
+                    break;
+                case 59:
+                    crc = (arg & 1);
+                    out.push_back(r1);
+                    break;
+                default:
+                    out.push_back(r1 | 0x04);  // illegal command
+                    break;
+            }
+        }
+
+        DigitalOut *cs;
+        std::deque<uint8_t> out;    // bytes the card sends next
+        std::vector<uint8_t> frame; // command that is being received
+        std::vector<uint8_t> block; // data block that is being received
+        int mode;
+        unsigned long addr;         // next sector to read or write
+        bool idle, app, crc;
+        int inits;
+};
+
+#endif